@@ -0,0 +1,282 @@
+#include "../includes/async.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace TerreateIO::Async {
+using namespace TerreateIO::Defines;
+
+namespace {
+struct Detached {
+  struct promise_type {
+    Detached get_return_object() noexcept {
+      return {std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+Detached RunDetached(AsyncTask<void> task,
+                     Function<void(std::exception_ptr const &)> complete) {
+  std::exception_ptr error;
+  try {
+    co_await task;
+  } catch (...) {
+    error = std::current_exception();
+  }
+  complete(error);
+}
+} // namespace
+
+void EventLoop::Complete(std::exception_ptr const &error) {
+  LockGuard<Mutex> lock(mMutex);
+  if (error && !mError) {
+    mError = error;
+  }
+  if (--mActive == 0u) {
+    mCV.notify_all();
+  }
+}
+
+void EventLoop::Post(std::coroutine_handle<> const &handle) {
+  {
+    LockGuard<Mutex> lock(mMutex);
+    mReady.push(handle);
+  }
+  mCV.notify_one();
+}
+
+void EventLoop::Submit(Function<void()> const &operation,
+                       std::coroutine_handle<> const &handle) {
+  TerreateCore::Executor::Task task([this, operation, handle]() {
+    operation();
+    this->Post(handle);
+  });
+  mIOExecutor.Schedule(std::move(task));
+}
+
+void EventLoop::Spawn(AsyncTask<void> &&task) {
+  {
+    LockGuard<Mutex> lock(mMutex);
+    ++mActive;
+  }
+  Detached detached =
+      RunDetached(std::move(task), [this](std::exception_ptr const &error) {
+        this->Complete(error);
+      });
+  this->Post(detached.handle);
+}
+
+void EventLoop::Run() {
+  {
+    LockGuard<Mutex> lock(mMutex);
+    mStop = false;
+  }
+  while (true) {
+    std::coroutine_handle<> handle;
+    {
+      UniqueLock<Mutex> lock(mMutex);
+      mCV.wait(lock, [this]() {
+        return mStop || !mReady.empty() || mActive == 0u;
+      });
+      if (mStop || mReady.empty()) {
+        break;
+      }
+      handle = mReady.front();
+      mReady.pop();
+    }
+    handle.resume();
+  }
+
+  LockGuard<Mutex> lock(mMutex);
+  if (mError && mActive == 0u) {
+    std::exception_ptr error = mError;
+    mError = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void EventLoop::Stop() {
+  {
+    LockGuard<Mutex> lock(mMutex);
+    mStop = true;
+  }
+  mCV.notify_all();
+}
+
+void IOOperation::await_suspend(std::coroutine_handle<> const &handle) {
+  mLoop.Submit(
+      [this]() {
+        mResult = mOperation();
+        mError = mResult < 0 ? errno : 0;
+      },
+      handle);
+}
+
+Size IOOperation::await_resume() const {
+  if (mResult < 0) {
+    throw Exception::IOException(std::strerror(mError));
+  }
+  return static_cast<Size>(mResult);
+}
+
+AsyncFile::AsyncFile(EventLoop &loop, Str const &path, OpenMode const &mode)
+    : mLoop(loop), mPath(path) {
+  int flags = O_CLOEXEC;
+  switch (mode) {
+  case OpenMode::READ:
+    flags |= O_RDONLY;
+    break;
+  case OpenMode::WRITE:
+    flags |= O_WRONLY | O_CREAT | O_TRUNC;
+    break;
+  case OpenMode::READ_WRITE:
+    flags |= O_RDWR | O_CREAT;
+    break;
+  }
+  mDescriptor = open(path.c_str(), flags, 0644);
+  if (mDescriptor < 0) {
+    throw Exception::IOException("Failed to open file: " + path);
+  }
+}
+
+AsyncFile::~AsyncFile() {
+  if (mDescriptor >= 0) {
+    close(mDescriptor);
+  }
+}
+
+Long AsyncFile::ReadFully(Byte *data, Size const &size,
+                          Size const &offset) const {
+  Size total = 0u;
+  while (total < size) {
+    ssize_t result =
+        pread(mDescriptor, data + total, size - total, offset + total);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    if (result == 0) {
+      break;
+    }
+    total += result;
+  }
+  return static_cast<Long>(total);
+}
+
+Long AsyncFile::WriteFully(Byte const *data, Size const &size,
+                           Size const &offset) const {
+  Size total = 0u;
+  while (total < size) {
+    ssize_t result =
+        pwrite(mDescriptor, data + total, size - total, offset + total);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    total += result;
+  }
+  return static_cast<Long>(total);
+}
+
+Size AsyncFile::GetSize() const {
+  struct stat info;
+  if (fstat(mDescriptor, &info) != 0) {
+    throw Exception::IOException("Failed to stat file: " + mPath);
+  }
+  return static_cast<Size>(info.st_size);
+}
+
+IOOperation AsyncFile::ReadAt(Byte *data, Size const &size,
+                              Size const &offset) {
+  return IOOperation(mLoop, [this, data, size, offset]() {
+    return this->ReadFully(data, size, offset);
+  });
+}
+
+IOOperation AsyncFile::WriteAt(Byte const *data, Size const &size,
+                               Size const &offset) {
+  return IOOperation(mLoop, [this, data, size, offset]() {
+    return this->WriteFully(data, size, offset);
+  });
+}
+
+AsyncTask<Buffer::ReadBuffer> AsyncFile::LoadAsync() {
+  TIO_SCOPE(mPath, LOAD);
+  Size size = this->GetSize();
+  if (size == 0u) {
+    co_return Buffer::ReadBuffer();
+  }
+  Byte *data = new Byte[size];
+  TIO_COUNT(ALLOCATIONS, 1u);
+  Buffer::ReadBuffer buffer(data, size);
+  Size read = co_await this->ReadAt(data, size, 0u);
+  if (read < size) {
+    buffer.Crop(0u, read);
+  }
+  co_return std::move(buffer);
+}
+
+AsyncReader::~AsyncReader() {
+  if (mPending != nullptr) {
+    delete[] mPending;
+  }
+}
+
+void AsyncReader::Refill(Size const &size,
+                         std::coroutine_handle<> const &handle) {
+  // Carry the unread tail of the current chunk over into the new one.
+  Size available = this->GetAvailable();
+  Size capacity = std::max(mChunkSize, size);
+  mPending = new Byte[capacity];
+  TIO_COUNT(ALLOCATIONS, 1u);
+  mPendingSize = available;
+  if (available > 0u) {
+    std::memcpy(mPending, mChunk.GetData() + mChunk.GetPosition(), available);
+  }
+  Byte *target = mPending + available;
+  Size request = capacity - available;
+  Size offset = mOffset;
+  mFile.GetLoop().Submit(
+      [this, target, request, offset]() {
+        mResult = mFile.ReadFully(target, request, offset);
+        mError = mResult < 0 ? errno : 0;
+      },
+      handle);
+}
+
+void AsyncReader::FinishRefill() {
+  Byte *data = mPending;
+  mPending = nullptr;
+  if (mResult < 0) {
+    delete[] data;
+    throw Exception::IOException(std::strerror(mError));
+  }
+  mOffset += mResult;
+  mChunk = Buffer::ReadBuffer(data, mPendingSize + mResult);
+}
+
+AsyncTask<void> AsyncWriter::FlushAsync() {
+  Str data = mBuffer.Dump();
+  mBuffer.Clear();
+  Size offset = mOffset;
+  mOffset += data.size();
+  if (!data.empty()) {
+    co_await mFile.WriteAt((Byte const *)data.data(), data.size(), offset);
+  }
+}
+} // namespace TerreateIO::Async
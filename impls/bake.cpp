@@ -0,0 +1,318 @@
+#include "../includes/bake.hpp"
+#include "../includes/hash.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+
+#ifdef _WIN32
+#include <process.h>
+#define TERREATEIO_GETPID _getpid
+#else
+#include <unistd.h>
+#define TERREATEIO_GETPID getpid
+#endif
+
+namespace TerreateIO::Bake {
+using namespace TerreateIO::Defines;
+namespace fs = std::filesystem;
+
+namespace {
+constexpr char const *ENTRY_EXTENSION = ".tiob";
+constexpr char const *TEMPORARY_EXTENSION = ".tmp";
+constexpr auto STALE_TEMPORARY_AGE = chrono::minutes(10);
+constexpr Size BAKE_EVICTION_FRACTION = 4u;
+
+Atomic<Ulong> sTemporaryCounter = 0u;
+
+struct EntryInfo {
+  fs::path path;
+  Size size;
+  fs::file_time_type time;
+};
+
+Str NormalizePath(Str const &path) {
+  return fs::absolute(fs::path(path)).lexically_normal().string();
+}
+
+// Lists the entries in `directory` and removes stale temporary files.
+Size ScanDirectory(Str const &directory, Vec<EntryInfo> &entries) {
+  std::error_code error;
+  auto now = fs::file_time_type::clock::now();
+  Size usage = 0u;
+  for (auto const &file : fs::directory_iterator(directory, error)) {
+    std::error_code fileError;
+    auto time = file.last_write_time(fileError);
+    if (fileError) {
+      continue;
+    }
+    auto extension = file.path().extension();
+    if (extension == TEMPORARY_EXTENSION) {
+      // Leftovers of processes that died while writing an entry.
+      if (now - time > STALE_TEMPORARY_AGE) {
+        fs::remove(file.path(), fileError);
+      }
+      continue;
+    }
+    if (extension != ENTRY_EXTENSION) {
+      continue;
+    }
+    Size size = file.file_size(fileError);
+    if (fileError) {
+      continue;
+    }
+    entries.push_back({file.path(), size, time});
+    usage += size;
+  }
+  return usage;
+}
+
+Size GetPayloadOffset(Size const &pathSize) {
+  return (sizeof(EntryHeader) + pathSize + 7u) / 8u * 8u;
+}
+
+Str ToHex(Ulong const &value) {
+  Stream stream;
+  stream << std::hex << std::setw(16) << std::setfill('0') << value;
+  return stream.str();
+}
+} // namespace
+
+BakeCache::BakeCache(Str const &directory, Size const &capacity)
+    : mDirectory(directory), mCapacity(capacity) {
+  std::error_code error;
+  fs::create_directories(mDirectory, error);
+  if (error) {
+    throw Exception::CacheException("Failed to create cache directory: " +
+                                    mDirectory);
+  }
+  Vec<EntryInfo> entries;
+  mUsage = ScanDirectory(mDirectory, entries);
+  this->Evict();
+}
+
+Str BakeCache::GetEntryPath(Str const &source) const {
+  return (fs::path(mDirectory) /
+          (ToHex(Hash::HashString(source)) + ENTRY_EXTENSION))
+      .string();
+}
+
+Bool BakeCache::OpenEntry(Str const &entry, Str const &source,
+                          Uint const &bakerVersion, Buffer::ReadBuffer &buffer,
+                          EntryHeader &header) const {
+  // The entry is mapped once and validated from the mapping, so a concurrent
+  // rename can never mix the header of one entry with the payload of another.
+  try {
+    buffer.MapFile(entry);
+  } catch (Exception::BufferException const &) {
+    return false;
+  }
+  if (buffer.GetSize() < sizeof(EntryHeader)) {
+    return false;
+  }
+  std::memcpy(&header, buffer.GetData(), sizeof(EntryHeader));
+  if (header.magic != BAKE_MAGIC || header.version != BAKE_VERSION ||
+      header.bakerVersion != bakerVersion || header.pathSize != source.size()) {
+    return false;
+  }
+  if (header.payloadOffset != GetPayloadOffset(header.pathSize) ||
+      header.payloadOffset > buffer.GetSize() ||
+      header.payloadSize != buffer.GetSize() - header.payloadOffset) {
+    return false;
+  }
+  return std::memcmp(buffer.GetData() + sizeof(EntryHeader), source.data(),
+                     source.size()) == 0;
+}
+
+void BakeCache::Store(Str const &entry, Str const &source,
+                      EntryHeader const &header, Byte const *payload) {
+  // Entries are written to a unique temporary file and renamed into place, so
+  // other processes either see the old entry or the complete new one.
+  Str temporary = entry + "." + ToStr(TERREATEIO_GETPID()) + "." +
+                  ToStr(sTemporaryCounter++) + TEMPORARY_EXTENSION;
+  {
+    OutputFileStream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      throw Exception::CacheException("Failed to create cache entry: " +
+                                      temporary);
+    }
+    file.write((char const *)&header, sizeof(EntryHeader));
+    file.write(source.data(), source.size());
+    Size padding = header.payloadOffset - sizeof(EntryHeader) - source.size();
+    for (Size i = 0; i < padding; ++i) {
+      file.put(0);
+    }
+    file.write((char const *)payload, header.payloadSize);
+    if (!file) {
+      file.close();
+      std::error_code error;
+      fs::remove(temporary, error);
+      throw Exception::CacheException("Failed to write cache entry: " +
+                                      temporary);
+    }
+  }
+
+  std::error_code error;
+  Size replaced = fs::file_size(entry, error);
+  if (error) {
+    replaced = 0u;
+  }
+  fs::rename(temporary, entry, error);
+  if (error) {
+    fs::remove(temporary, error);
+    throw Exception::CacheException("Failed to commit cache entry: " + entry);
+  }
+  this->UpdateUsage(header.payloadOffset + header.payloadSize, replaced);
+}
+
+void BakeCache::UpdateUsage(Size const &added, Size const &removed) {
+  LockGuard<Mutex> lock(mMutex);
+  mUsage += added;
+  mUsage -= std::min(mUsage, removed);
+}
+
+void BakeCache::Evict() {
+  LockGuard<Mutex> lock(mMutex);
+  Size capacity = mCapacity.load();
+  if (mUsage <= capacity) {
+    return;
+  }
+  // Other processes may share the directory, so the actual usage is only
+  // known after a scan.
+  Vec<EntryInfo> entries;
+  mUsage = ScanDirectory(mDirectory, entries);
+  if (mUsage <= capacity) {
+    return;
+  }
+
+  // Evicting down to a lower target keeps a full cache from scanning the
+  // directory again on every miss.
+  Size target = capacity - capacity / BAKE_EVICTION_FRACTION;
+  // Hits refresh the timestamp of an entry, so the oldest one is the least
+  // recently used across all processes sharing the directory.
+  std::sort(entries.begin(), entries.end(),
+            [](EntryInfo const &a, EntryInfo const &b) {
+              return a.time < b.time;
+            });
+  std::error_code error;
+  for (auto const &entry : entries) {
+    if (mUsage <= target) {
+      break;
+    }
+    if (fs::remove(entry.path, error)) {
+      mUsage -= entry.size;
+    }
+  }
+}
+
+Size BakeCache::GetUsage() const {
+  std::error_code error;
+  Size usage = 0u;
+  for (auto const &file : fs::directory_iterator(mDirectory, error)) {
+    if (file.path().extension() != ENTRY_EXTENSION) {
+      continue;
+    }
+    std::error_code fileError;
+    Size size = file.file_size(fileError);
+    if (!fileError) {
+      usage += size;
+    }
+  }
+  return usage;
+}
+
+void BakeCache::SetCapacity(Size const &capacity) {
+  mCapacity = capacity;
+  this->Evict();
+}
+
+void BakeCache::Load(Str const &source, Buffer::ReadBuffer &output,
+                     Baker const &baker, Uint const &bakerVersion) {
+  Str path = NormalizePath(source);
+  TIO_SCOPE(path, LOAD);
+  std::error_code error;
+  Size size = fs::file_size(path, error);
+  if (error) {
+    throw Exception::CacheException("Failed to stat source: " + path);
+  }
+  Long time = fs::last_write_time(path, error).time_since_epoch().count();
+  if (error) {
+    throw Exception::CacheException("Failed to stat source: " + path);
+  }
+  Str entry = this->GetEntryPath(path);
+
+  Buffer::ReadBuffer sourceBuffer;
+  Buffer::ReadBuffer cached;
+  EntryHeader header;
+  Bool hit = false;
+  if (this->OpenEntry(entry, path, bakerVersion, cached, header) &&
+      header.sourceSize == size) {
+    if (header.sourceTime == time) {
+      fs::last_write_time(entry, fs::file_time_type::clock::now(), error);
+      hit = true;
+    } else {
+      // Only trust the entry if the content did not change with the timestamp.
+      sourceBuffer.MapFile(path);
+      if (Hash::HashBytes(sourceBuffer.GetData(), sourceBuffer.GetSize()) ==
+          header.sourceHash) {
+        header.sourceTime = time;
+        this->Store(entry, path, header,
+                    cached.GetData() + header.payloadOffset);
+        hit = true;
+      }
+    }
+  }
+  if (hit) {
+    cached.Crop(header.payloadOffset, header.payloadSize);
+    output = std::move(cached);
+    ++mHits;
+    return;
+  }
+
+  ++mMisses;
+  if (!sourceBuffer.IsMapped()) {
+    sourceBuffer.MapFile(path);
+  }
+  Ulong hash = Hash::HashBytes(sourceBuffer.GetData(), sourceBuffer.GetSize());
+  Buffer::WriteBuffer baked;
+  {
+    TIO_SCOPE(path, DECODE);
+    baker(sourceBuffer, baked);
+  }
+  Str payload = baked.Dump();
+
+  header = {BAKE_MAGIC,
+            BAKE_VERSION,
+            bakerVersion,
+            static_cast<Uint>(path.size()),
+            sourceBuffer.GetSize(),
+            time,
+            hash,
+            GetPayloadOffset(path.size()),
+            payload.size()};
+  this->Store(entry, path, header, (Byte const *)payload.data());
+  this->Evict();
+  output = Buffer::ReadBuffer(payload);
+}
+
+void BakeCache::Invalidate(Str const &source) {
+  Str entry = this->GetEntryPath(NormalizePath(source));
+  std::error_code error;
+  Size size = fs::file_size(entry, error);
+  if (!error && fs::remove(entry, error)) {
+    this->UpdateUsage(0u, size);
+  }
+}
+
+void BakeCache::Clear() {
+  LockGuard<Mutex> lock(mMutex);
+  std::error_code error;
+  for (auto const &file : fs::directory_iterator(mDirectory, error)) {
+    if (file.path().extension() == ENTRY_EXTENSION) {
+      std::error_code fileError;
+      fs::remove(file.path(), fileError);
+    }
+  }
+  mUsage = 0u;
+}
+} // namespace TerreateIO::Bake
@@ -1,19 +1,136 @@
 #include "../includes/buffer.hpp"
 
+#include <algorithm>
+
+#ifdef _WIN32
+#include <filesystem>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace TerreateIO::Buffer {
 using namespace TerreateIO::Defines;
 
-ReadBuffer::~ReadBuffer() {
-  if (mBuffer != nullptr) {
-    delete[] mBuffer;
+void ReadBuffer::Release() {
+  if (mStorage != nullptr) {
+    if (mMapped) {
+#ifndef _WIN32
+      munmap(mStorage, mStorageSize);
+#endif
+    } else {
+      delete[] mStorage;
+    }
+  }
+  mStorage = nullptr;
+  mStorageSize = 0u;
+  mMapped = false;
+  mBuffer = nullptr;
+  mCursor = nullptr;
+  mSize = 0u;
+}
+
+ReadBuffer::ReadBuffer(ReadBuffer &&buffer) noexcept
+    : TerreateObjectBase(buffer), mStorage(buffer.mStorage),
+      mStorageSize(buffer.mStorageSize), mMapped(buffer.mMapped),
+      mBuffer(buffer.mBuffer), mCursor(buffer.mCursor), mSize(buffer.mSize) {
+  buffer.mStorage = nullptr;
+  buffer.Release();
+}
+
+ReadBuffer::~ReadBuffer() { this->Release(); }
+
+void ReadBuffer::MapFile(Str const &path, Size const &offset,
+                         Size const &size) {
+  this->Release();
+#ifdef _WIN32
+  InputFileStream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    throw Exception::BufferException("Failed to open file: " + path);
+  }
+  Size fileSize = std::filesystem::file_size(path);
+  if (offset > fileSize) {
+    throw Exception::BufferException("Mapping out of bounds: " + path);
+  }
+  Size length = std::min(size, fileSize - offset);
+  if (length == 0u) {
+    return;
+  }
+  mStorage = new Byte[length];
+  TIO_COUNT(ALLOCATIONS, 1u);
+  mStorageSize = length;
+  file.seekg(offset);
+  file.read((char *)mStorage, length);
+  mBuffer = mStorage;
+  mCursor = mBuffer;
+  mSize = length;
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw Exception::BufferException("Failed to open file: " + path);
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    throw Exception::BufferException("Failed to stat file: " + path);
+  }
+  Size fileSize = info.st_size;
+  if (offset > fileSize) {
+    close(fd);
+    throw Exception::BufferException("Mapping out of bounds: " + path);
+  }
+  Size length = std::min(size, fileSize - offset);
+  if (length == 0u) {
+    close(fd);
+    return;
+  }
+  // mmap offsets have to be page aligned.
+  Size page = static_cast<Size>(sysconf(_SC_PAGESIZE));
+  Size base = offset / page * page;
+  Size mappingSize = length + (offset - base);
+  void *mapped =
+      mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, (off_t)base);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    throw Exception::BufferException("Failed to map file: " + path);
+  }
+  mStorage = (Byte *)mapped;
+  mStorageSize = mappingSize;
+  mMapped = true;
+  mBuffer = mStorage + (offset - base);
+  mCursor = mBuffer;
+  mSize = length;
+#endif
+}
+
+void ReadBuffer::Crop(Size const &offset, Size const &size) {
+  if (offset > mSize || size > mSize - offset) {
+    TIO_COUNT(BOUNDS_FAILURES, 1u);
+    throw Exception::BufferException("Buffer out of bounds");
   }
+  mBuffer += offset;
+  mCursor = mBuffer;
+  mSize = size;
+}
+
+ReadBuffer ReadBuffer::View() const {
+  ReadBuffer view;
+  view.mBuffer = mBuffer;
+  view.mCursor = mBuffer;
+  view.mSize = mSize;
+  return view;
 }
 
 Str ReadBuffer::Fetch(Size const &size) {
   Str result;
   if (mCursor + size > mBuffer + mSize) {
+    TIO_COUNT(BOUNDS_FAILURES, 1u);
     throw Exception::BufferException("Buffer out of bounds");
   } else {
+    TIO_COUNT(FETCH_CALLS, 1u);
+    TIO_COUNT(BYTES_READ, size);
     result = Str(mCursor, mCursor + size);
     mCursor += size;
   }
@@ -23,8 +140,11 @@ Str ReadBuffer::Fetch(Size const &size) {
 Str ReadBuffer::Read(Size const &size) {
   Str result;
   if (mCursor + size > mBuffer + mSize) {
+    TIO_COUNT(BOUNDS_FAILURES, 1u);
     throw Exception::BufferException("Buffer out of bounds");
   } else {
+    TIO_COUNT(READ_CALLS, 1u);
+    TIO_COUNT(BYTES_READ, size);
     result = Str(mCursor, mCursor + size);
   }
   return result;
@@ -32,6 +152,7 @@ Str ReadBuffer::Read(Size const &size) {
 
 void ReadBuffer::Skip(Size const &size) {
   if (mCursor + size > mBuffer + mSize) {
+    TIO_COUNT(BOUNDS_FAILURES, 1u);
     throw Exception::BufferException("Buffer out of bounds");
   } else {
     mCursor += size;
@@ -48,10 +169,11 @@ void ReadBuffer::SkipWhitespace() {
 
 ReadBuffer &ReadBuffer::operator=(ReadBuffer const &buffer) {
   if (this != &buffer) {
-    if (mBuffer != nullptr) {
-      delete[] mBuffer;
-    }
-    mBuffer = new Byte[buffer.mSize];
+    this->Release();
+    mStorage = new Byte[buffer.mSize];
+    TIO_COUNT(ALLOCATIONS, 1u);
+    mStorageSize = buffer.mSize;
+    mBuffer = mStorage;
     mCursor = mBuffer;
     mSize = buffer.mSize;
     std::memcpy(mBuffer, buffer.mBuffer, buffer.mSize);
@@ -59,6 +181,40 @@ ReadBuffer &ReadBuffer::operator=(ReadBuffer const &buffer) {
   return *this;
 }
 
+ReadBuffer &ReadBuffer::operator=(ReadBuffer &&buffer) noexcept {
+  if (this != &buffer) {
+    this->Release();
+    mStorage = buffer.mStorage;
+    mStorageSize = buffer.mStorageSize;
+    mMapped = buffer.mMapped;
+    mBuffer = buffer.mBuffer;
+    mCursor = buffer.mCursor;
+    mSize = buffer.mSize;
+    buffer.mStorage = nullptr;
+    buffer.Release();
+  }
+  return *this;
+}
+
+void WriteBuffer::Align(Size const &alignment) {
+  Size padding = (alignment - this->GetSize() % alignment) % alignment;
+  for (Size i = 0; i < padding; ++i) {
+    mStream.put(0);
+  }
+}
+
+void WriteBuffer::Patch(Size const &offset, Byte const *data,
+                        Size const &size) {
+  auto end = mStream.tellp();
+  if (offset + size > static_cast<Size>(end)) {
+    TIO_COUNT(BOUNDS_FAILURES, 1u);
+    throw Exception::BufferException("Buffer out of bounds");
+  }
+  mStream.seekp(offset);
+  mStream.write((const char *)data, size);
+  mStream.seekp(end);
+}
+
 WriteBuffer &WriteBuffer::operator=(WriteBuffer const &buffer) {
   if (this != &buffer) {
     mStream.str(buffer.mStream.str());
@@ -0,0 +1,165 @@
+#include "../includes/cache.hpp"
+#include "../includes/hash.hpp"
+
+#include <iomanip>
+
+namespace TerreateIO::Cache {
+using namespace TerreateIO::Defines;
+
+AssetCache::Shard &AssetCache::GetShard(Str const &key) {
+  return mShards[Hash::HashString(key) % CACHE_NUM_SHARDS];
+}
+
+void AssetCache::Erase(Shard &shard, Map<Str, Entry>::iterator const &entry) {
+  if (shard.hand == entry->second.position) {
+    ++shard.hand;
+  }
+  shard.clock.erase(entry->second.position);
+  if (entry->second.ready) {
+    mUsage -= entry->second.size;
+  }
+  shard.entries.erase(entry);
+}
+
+void AssetCache::Sweep(Shard &shard, Size const &budget) {
+  Size steps = shard.clock.size();
+  while (mUsage.load() > budget && steps-- > 0u) {
+    if (shard.hand == shard.clock.end()) {
+      shard.hand = shard.clock.begin();
+    }
+    auto entry = shard.entries.find(*shard.hand);
+    if (!entry->second.ready) {
+      ++shard.hand;
+    } else if (entry->second.referenced) {
+      entry->second.referenced = false;
+      ++shard.hand;
+    } else {
+      this->Erase(shard, entry);
+    }
+  }
+}
+
+void AssetCache::Evict() {
+  Size budget = mBudget.load();
+  // One sweep per shard clears every reference bit, so two rounds without
+  // getting under budget means only loading entries are left.
+  for (Size i = 0u; i < 2u * CACHE_NUM_SHARDS && mUsage.load() > budget;
+       ++i) {
+    Shard &shard = mShards[mEvictionShard++ % CACHE_NUM_SHARDS];
+    LockGuard<Mutex> lock(shard.mutex);
+    this->Sweep(shard, budget);
+  }
+}
+
+void AssetCache::SetBudget(Size const &budget) {
+  mBudget = budget;
+  this->Evict();
+}
+
+SharedBuffer AssetCache::Acquire(Str const &key, Loader const &loader) {
+  Shard &shard = this->GetShard(key);
+  std::promise<SharedBuffer> promise;
+  SharedFuture<SharedBuffer> future;
+  Ulong generation = 0u;
+  {
+    LockGuard<Mutex> lock(shard.mutex);
+    auto entry = shard.entries.find(key);
+    if (entry != shard.entries.end()) {
+      entry->second.referenced = true;
+      future = entry->second.future;
+    } else {
+      generation = ++shard.generation;
+      Entry &created = shard.entries[key];
+      created.generation = generation;
+      created.future = promise.get_future().share();
+      created.position = shard.clock.insert(shard.clock.end(), key);
+    }
+  }
+  if (generation == 0u) {
+    ++mHits;
+    return future.get();
+  }
+
+  ++mMisses;
+  SharedBuffer buffer;
+  try {
+    TIO_SCOPE(key, DECODE);
+    auto decoded = std::make_shared<Buffer::ReadBuffer>();
+    loader(*decoded);
+    buffer = decoded;
+  } catch (...) {
+    promise.set_exception(std::current_exception());
+    LockGuard<Mutex> lock(shard.mutex);
+    auto entry = shard.entries.find(key);
+    if (entry != shard.entries.end() &&
+        entry->second.generation == generation) {
+      this->Erase(shard, entry);
+    }
+    throw;
+  }
+  promise.set_value(buffer);
+
+  {
+    LockGuard<Mutex> lock(shard.mutex);
+    auto entry = shard.entries.find(key);
+    // The entry may have been invalidated while it was loading.
+    if (entry == shard.entries.end() ||
+        entry->second.generation != generation) {
+      return buffer;
+    }
+    entry->second.ready = true;
+    entry->second.size = buffer->GetSize();
+    mUsage += buffer->GetSize();
+  }
+  this->Evict();
+  return buffer;
+}
+
+SharedBuffer AssetCache::Acquire(Ulong const &contentHash,
+                                 Loader const &loader) {
+  Stream key;
+  key << '#' << std::hex << std::setw(16) << std::setfill('0') << contentHash;
+  return this->Acquire(key.str(), loader);
+}
+
+SharedBuffer AssetCache::Find(Str const &key) {
+  Shard &shard = this->GetShard(key);
+  LockGuard<Mutex> lock(shard.mutex);
+  auto entry = shard.entries.find(key);
+  if (entry == shard.entries.end() || !entry->second.ready) {
+    return nullptr;
+  }
+  entry->second.referenced = true;
+  return entry->second.future.get();
+}
+
+void AssetCache::Invalidate(Str const &key) {
+  Shard &shard = this->GetShard(key);
+  LockGuard<Mutex> lock(shard.mutex);
+  auto entry = shard.entries.find(key);
+  if (entry != shard.entries.end()) {
+    this->Erase(shard, entry);
+  }
+}
+
+void AssetCache::Clear() {
+  for (auto &shard : mShards) {
+    LockGuard<Mutex> lock(shard.mutex);
+    Size usage = 0u;
+    for (auto const &entry : shard.entries) {
+      if (entry.second.ready) {
+        usage += entry.second.size;
+      }
+    }
+    shard.entries.clear();
+    shard.clock.clear();
+    shard.hand = shard.clock.end();
+    mUsage -= usage;
+  }
+}
+
+AssetCache &AssetCache::GetGlobal() {
+  static AssetCache cache;
+  return cache;
+}
+} // namespace TerreateIO::Cache
@@ -0,0 +1,409 @@
+#include "../includes/container.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace TerreateIO::Container {
+using namespace TerreateIO::Defines;
+
+namespace {
+Size AlignUp(Size const &value, Size const &alignment) {
+  return (value + alignment - 1u) / alignment * alignment;
+}
+
+Bool IsValidAlignment(Size const &alignment) {
+  return alignment != 0u && alignment <= CONTAINER_ALIGNMENT &&
+         (alignment & (alignment - 1u)) == 0u;
+}
+} // namespace
+
+FieldEntry Table::GetFieldEntry(Ushort const &id) const {
+  // Missing tables behave like tables without fields.
+  if (!this->IsValid()) {
+    return FieldEntry{0u, 0u, 0u, 0u};
+  }
+  Offset vtable = Load<Offset>(mBuffer, mOffset);
+  if (id >= Load<Ushort>(mBuffer, vtable)) {
+    return FieldEntry{0u, 0u, 0u, 0u};
+  }
+  return Load<FieldEntry>(mBuffer, vtable + 2 * sizeof(Ushort) +
+                                       id * sizeof(FieldEntry));
+}
+
+Offset Table::GetFieldOffset(Ushort const &id, FieldKind const &kind,
+                             Size const &size, Size const &alignment) const {
+  FieldEntry entry = this->GetFieldEntry(id);
+  if (entry.offset == 0u || entry.kind != static_cast<Ubyte>(kind) ||
+      entry.size != size || entry.alignment < alignment) {
+    return 0u;
+  }
+  return mOffset + entry.offset;
+}
+
+Offset Table::GetReference(Ushort const &id, FieldKind const &kind,
+                           Size const &size, Size const &alignment) const {
+  Offset offset = this->GetFieldOffset(id, kind, size, alignment);
+  return offset == 0u ? 0u : Load<Offset>(mBuffer, offset);
+}
+
+Table Table::GetTable(Ushort const &id) const {
+  Offset offset = this->GetReference(id, FieldKind::TABLE, sizeof(Offset),
+                                     alignof(Offset));
+  return offset == 0u ? Table() : Table(mBuffer, offset);
+}
+
+std::string_view Table::GetString(Ushort const &id) const {
+  Offset offset = this->GetReference(id, FieldKind::STRING, sizeof(char),
+                                     alignof(char));
+  if (offset == 0u) {
+    return std::string_view();
+  }
+  return std::string_view((char const *)mBuffer + offset + sizeof(Uint),
+                          Load<Uint>(mBuffer, offset));
+}
+
+TableVector Table::GetTableVector(Ushort const &id) const {
+  Offset offset = this->GetReference(id, FieldKind::TABLE_VECTOR,
+                                     sizeof(Offset), alignof(Offset));
+  if (offset == 0u) {
+    return TableVector();
+  }
+  return TableVector(mBuffer, offset + sizeof(Uint),
+                     Load<Uint>(mBuffer, offset));
+}
+
+ContainerWriter::ContainerWriter(Buffer::WriteBuffer &buffer)
+    : mBuffer(buffer) {
+  mBuffer.Align(CONTAINER_ALIGNMENT);
+  mBase = mBuffer.GetSize();
+  mBuffer.Write(Header{});
+}
+
+void ContainerWriter::CheckSize() const {
+  if (mBuffer.GetSize() - mBase > std::numeric_limits<Offset>::max()) {
+    throw Exception::ContainerException("Container exceeds 4GiB");
+  }
+}
+
+Offset ContainerWriter::GetPosition() const {
+  this->CheckSize();
+  return static_cast<Offset>(mBuffer.GetSize() - mBase);
+}
+
+void ContainerWriter::CheckWritable() const {
+  if (mFinished) {
+    throw Exception::ContainerException("Container is already finished");
+  }
+}
+
+void ContainerWriter::AddField(Ushort const &id, FieldKind const &kind,
+                               Ushort const &size, Ubyte const &alignment,
+                               Byte const *data) {
+  if (!mInTable) {
+    throw Exception::ContainerException("No table is being built");
+  }
+  // The vtable stores the field count in a Ushort, so the last id is unusable.
+  if (id >= CONTAINER_MAX_FIELDS) {
+    throw Exception::ContainerException("Field " + ToStr(id) +
+                                        " is out of range");
+  }
+  for (auto const &field : mFields) {
+    if (field.id == id) {
+      throw Exception::ContainerException("Field " + ToStr(id) +
+                                          " is already set");
+    }
+  }
+  Size dataIndex = mFieldData.size();
+  Size storedSize = kind == FieldKind::SCALAR ? size : sizeof(Offset);
+  mFieldData.append((char const *)data, storedSize);
+  mFields.push_back({id, kind, size, alignment, dataIndex});
+}
+
+Offset ContainerWriter::BeginVector(Uint const &count, Size const &alignment) {
+  this->CheckWritable();
+  mBuffer.Align(std::max<Size>(alignment, sizeof(Uint)));
+  while ((this->GetPosition() + sizeof(Uint)) % alignment != 0u) {
+    mBuffer.Write((Ubyte)0u);
+  }
+  Offset offset = this->GetPosition();
+  mBuffer.Write(count);
+  return offset;
+}
+
+Offset ContainerWriter::WriteVTable(Str const &vtable) {
+  auto iter = mVTables.find(vtable);
+  if (iter != mVTables.end()) {
+    return iter->second;
+  }
+  mBuffer.Align(sizeof(Ushort));
+  Offset offset = this->GetPosition();
+  mBuffer.Write(vtable);
+  mVTables.emplace(vtable, offset);
+  return offset;
+}
+
+StringRef ContainerWriter::CreateString(Str const &string) {
+  Offset offset = this->BeginVector(static_cast<Uint>(string.size()), 1u);
+  mBuffer.Write(string);
+  mBuffer.Write((Ubyte)0u);
+  this->CheckSize();
+  return StringRef{offset};
+}
+
+TableVectorRef
+ContainerWriter::CreateTableVector(Vec<TableRef> const &tables) {
+  Offset offset =
+      this->BeginVector(static_cast<Uint>(tables.size()), sizeof(Offset));
+  for (auto const &table : tables) {
+    mBuffer.Write(table.offset);
+  }
+  this->CheckSize();
+  return TableVectorRef{offset};
+}
+
+void ContainerWriter::StartTable() {
+  this->CheckWritable();
+  if (mInTable) {
+    throw Exception::ContainerException("Tables cannot be nested while built");
+  }
+  mInTable = true;
+  mFields.clear();
+  mFieldData.clear();
+}
+
+void ContainerWriter::AddTable(Ushort const &id, TableRef const &table) {
+  this->AddField(id, FieldKind::TABLE, sizeof(Offset), alignof(Offset),
+                 (Byte const *)&table.offset);
+}
+
+void ContainerWriter::AddString(Ushort const &id, StringRef const &string) {
+  this->AddField(id, FieldKind::STRING, sizeof(char), alignof(char),
+                 (Byte const *)&string.offset);
+}
+
+void ContainerWriter::AddTableVector(Ushort const &id,
+                                     TableVectorRef const &vector) {
+  this->AddField(id, FieldKind::TABLE_VECTOR, sizeof(Offset), alignof(Offset),
+                 (Byte const *)&vector.offset);
+}
+
+TableRef ContainerWriter::EndTable() {
+  if (!mInTable) {
+    throw Exception::ContainerException("No table is being built");
+  }
+  mInTable = false;
+
+  // Place the widest fields first to keep padding inside the table minimal.
+  Vec<PendingField> order = mFields;
+  std::stable_sort(order.begin(), order.end(),
+                   [](PendingField const &a, PendingField const &b) {
+                     return a.alignment > b.alignment;
+                   });
+
+  Ushort numFields = 0u;
+  for (auto const &field : mFields) {
+    numFields = std::max<Ushort>(numFields, field.id + 1u);
+  }
+  Vec<FieldEntry> entries(numFields, FieldEntry{0u, 0u, 0u, 0u});
+  Vec<Size> positions;
+  Size tableSize = sizeof(Offset);
+  for (auto const &field : order) {
+    Size storedSize =
+        field.kind == FieldKind::SCALAR ? field.size : sizeof(Offset);
+    Size alignment = field.kind == FieldKind::SCALAR ? field.alignment
+                                                     : alignof(Offset);
+    tableSize = AlignUp(tableSize, alignment);
+    positions.push_back(tableSize);
+    entries[field.id] = {static_cast<Ushort>(tableSize), field.size,
+                         static_cast<Ubyte>(field.kind), field.alignment};
+    tableSize += storedSize;
+  }
+  if (tableSize > std::numeric_limits<Ushort>::max()) {
+    throw Exception::ContainerException("Table exceeds 64KiB");
+  }
+
+  Str vtable;
+  vtable.append((char const *)&numFields, sizeof(Ushort));
+  Ushort size = static_cast<Ushort>(tableSize);
+  vtable.append((char const *)&size, sizeof(Ushort));
+  vtable.append((char const *)entries.data(),
+                entries.size() * sizeof(FieldEntry));
+  Offset vtableOffset = this->WriteVTable(vtable);
+
+  mBuffer.Align(CONTAINER_ALIGNMENT);
+  Offset offset = this->GetPosition();
+  mBuffer.Write(vtableOffset);
+  for (Size i = 0; i < order.size(); ++i) {
+    auto const &field = order[i];
+    Size storedSize =
+        field.kind == FieldKind::SCALAR ? field.size : sizeof(Offset);
+    while (this->GetPosition() - offset < positions[i]) {
+      mBuffer.Write((Ubyte)0u);
+    }
+    mBuffer.Write((Byte const *)mFieldData.data() + field.dataIndex,
+                  storedSize);
+  }
+  this->CheckSize();
+  return TableRef{offset};
+}
+
+void ContainerWriter::Finish(TableRef const &root) {
+  this->CheckWritable();
+  if (mInTable) {
+    throw Exception::ContainerException("A table is still being built");
+  }
+  mBuffer.Align(CONTAINER_ALIGNMENT);
+  Header header = {CONTAINER_MAGIC, CONTAINER_VERSION, root.offset,
+                   this->GetPosition()};
+  mBuffer.Patch(mBase, header);
+  mFinished = true;
+}
+
+ContainerReader::ContainerReader(Buffer::ReadBuffer const &buffer)
+    : ContainerReader(buffer.GetData(), buffer.GetSize()) {}
+
+ContainerReader::ContainerReader(Byte const *buffer, Size const &size)
+    : mBuffer(buffer), mSize(size) {
+  if (mBuffer == nullptr || mSize < sizeof(Header)) {
+    throw Exception::ContainerException("Buffer is too small for a container");
+  }
+  if (reinterpret_cast<std::uintptr_t>(mBuffer) % CONTAINER_ALIGNMENT != 0u) {
+    throw Exception::ContainerException("Container buffer is misaligned");
+  }
+  Header header = Load<Header>(mBuffer, 0u);
+  if (header.magic != CONTAINER_MAGIC) {
+    throw Exception::ContainerException("Invalid container magic");
+  }
+  if (header.version != CONTAINER_VERSION) {
+    throw Exception::ContainerException("Unsupported container version " +
+                                        ToStr(header.version));
+  }
+  if (header.size < sizeof(Header) || header.size > mSize) {
+    throw Exception::ContainerException("Container size is out of bounds");
+  }
+  mSize = header.size;
+  if (header.root < sizeof(Header) || header.root % sizeof(Offset) != 0u ||
+      header.root + sizeof(Offset) > mSize) {
+    throw Exception::ContainerException("Root table is out of bounds");
+  }
+  mRoot = header.root;
+}
+
+Uint ContainerReader::VerifyVector(Offset const &offset, Offset const &owner,
+                                   Size const &elementSize,
+                                   Size const &alignment) const {
+  if (offset < sizeof(Header) || offset >= owner ||
+      offset % sizeof(Uint) != 0u || offset + sizeof(Uint) > mSize) {
+    throw Exception::ContainerException("Vector is out of bounds");
+  }
+  Uint count = Load<Uint>(mBuffer, offset);
+  Size data = offset + sizeof(Uint);
+  if (data % alignment != 0u) {
+    throw Exception::ContainerException("Vector data is misaligned");
+  }
+  if (data + static_cast<Size>(count) * elementSize > mSize) {
+    throw Exception::ContainerException("Vector data is out of bounds");
+  }
+  return count;
+}
+
+void ContainerReader::VerifyTable(Offset const &offset, Uint const &depth,
+                                  Uint const &maxDepth, Uint &numTables,
+                                  Uint const &maxTables) const {
+  if (depth > maxDepth) {
+    throw Exception::ContainerException("Container nesting is too deep");
+  }
+  if (++numTables > maxTables) {
+    throw Exception::ContainerException("Container has too many tables");
+  }
+  if (offset < sizeof(Header) || offset % sizeof(Offset) != 0u ||
+      offset + sizeof(Offset) > mSize) {
+    throw Exception::ContainerException("Table is out of bounds");
+  }
+
+  Offset vtable = Load<Offset>(mBuffer, offset);
+  if (vtable < sizeof(Header) || vtable % sizeof(Ushort) != 0u ||
+      vtable + 2 * sizeof(Ushort) > mSize) {
+    throw Exception::ContainerException("VTable is out of bounds");
+  }
+  Ushort numFields = Load<Ushort>(mBuffer, vtable);
+  Ushort tableSize = Load<Ushort>(mBuffer, vtable + sizeof(Ushort));
+  Size entries = vtable + 2 * sizeof(Ushort);
+  if (entries + numFields * sizeof(FieldEntry) > mSize) {
+    throw Exception::ContainerException("VTable entries are out of bounds");
+  }
+  if (tableSize < sizeof(Offset) || offset + tableSize > mSize) {
+    throw Exception::ContainerException("Table data is out of bounds");
+  }
+
+  for (Ushort id = 0u; id < numFields; ++id) {
+    FieldEntry entry =
+        Load<FieldEntry>(mBuffer, entries + id * sizeof(FieldEntry));
+    if (entry.offset == 0u) {
+      continue;
+    }
+    FieldKind kind = static_cast<FieldKind>(entry.kind);
+    Size storedSize = kind == FieldKind::SCALAR ? entry.size : sizeof(Offset);
+    Size storedAlignment =
+        kind == FieldKind::SCALAR ? entry.alignment : alignof(Offset);
+    if (entry.offset < sizeof(Offset) || entry.size == 0u ||
+        !IsValidAlignment(entry.alignment) ||
+        entry.offset + storedSize > tableSize ||
+        (offset + entry.offset) % storedAlignment != 0u) {
+      throw Exception::ContainerException("Field " + ToStr(id) +
+                                          " is malformed");
+    }
+
+    Offset field = offset + entry.offset;
+    switch (kind) {
+    case FieldKind::SCALAR:
+      break;
+    case FieldKind::TABLE: {
+      Offset table = Load<Offset>(mBuffer, field);
+      if (table >= offset) {
+        throw Exception::ContainerException("Table reference points forward");
+      }
+      this->VerifyTable(table, depth + 1u, maxDepth, numTables, maxTables);
+      break;
+    }
+    case FieldKind::VECTOR:
+      this->VerifyVector(Load<Offset>(mBuffer, field), offset, entry.size,
+                         entry.alignment);
+      break;
+    case FieldKind::STRING: {
+      Offset string = Load<Offset>(mBuffer, field);
+      Uint length = this->VerifyVector(string, offset, 1u, 1u);
+      Size terminator = string + sizeof(Uint) + length;
+      if (terminator >= mSize || mBuffer[terminator] != 0) {
+        throw Exception::ContainerException("String is not terminated");
+      }
+      break;
+    }
+    case FieldKind::TABLE_VECTOR: {
+      Offset vector = Load<Offset>(mBuffer, field);
+      Uint count = this->VerifyVector(vector, offset, sizeof(Offset),
+                                      alignof(Offset));
+      for (Uint i = 0u; i < count; ++i) {
+        Offset table =
+            Load<Offset>(mBuffer, vector + sizeof(Uint) + i * sizeof(Offset));
+        if (table >= vector) {
+          throw Exception::ContainerException(
+              "Table reference points forward");
+        }
+        this->VerifyTable(table, depth + 1u, maxDepth, numTables, maxTables);
+      }
+      break;
+    }
+    default:
+      throw Exception::ContainerException("Field " + ToStr(id) +
+                                          " has an unknown kind");
+    }
+  }
+}
+
+void ContainerReader::Verify(Uint const &maxDepth,
+                             Uint const &maxTables) const {
+  Uint numTables = 0u;
+  this->VerifyTable(mRoot, 0u, maxDepth, numTables, maxTables);
+}
+} // namespace TerreateIO::Container
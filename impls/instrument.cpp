@@ -0,0 +1,247 @@
+#include "../includes/instrument.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <iomanip>
+#include <memory>
+
+namespace TerreateIO::Instrument {
+using namespace TerreateIO::Defines;
+
+namespace {
+struct AtomicHistogram {
+  Atomic<Ulong> buckets[NUM_HISTOGRAM_BUCKETS];
+  Atomic<Ulong> count;
+  Atomic<Ulong> total;
+  Atomic<Ulong> max;
+};
+
+// Only the owning thread writes to a recorder, so updates are plain relaxed
+// load/store pairs instead of read-modify-write operations.
+struct ThreadRecorder {
+  Uint thread = 0u;
+  Atomic<Ulong> counters[NUM_COUNTERS];
+  AtomicHistogram histograms[NUM_LATENCIES];
+  Mutex mutex;
+  Vec<TraceStamp> stamps;
+};
+
+struct Registry {
+  Mutex mutex;
+  Vec<std::shared_ptr<ThreadRecorder>> recorders;
+  Snapshot baseline;
+  Atomic<Bool> tracing = false;
+  SteadyTimePoint origin = Now();
+};
+
+Registry &GetRegistry() {
+  static Registry registry;
+  return registry;
+}
+
+ThreadRecorder &GetRecorder() {
+  thread_local std::shared_ptr<ThreadRecorder> recorder = []() {
+    auto created = std::make_shared<ThreadRecorder>();
+    Registry &registry = GetRegistry();
+    LockGuard<Mutex> lock(registry.mutex);
+    created->thread = static_cast<Uint>(registry.recorders.size());
+    registry.recorders.push_back(created);
+    return created;
+  }();
+  return *recorder;
+}
+
+void Add(Atomic<Ulong> &value, Ulong const &amount) {
+  value.store(value.load(std::memory_order_relaxed) + amount,
+              std::memory_order_relaxed);
+}
+
+Str EscapeJson(Str const &string) {
+  Stream stream;
+  for (char c : string) {
+    switch (c) {
+    case '"':
+      stream << "\\\"";
+      break;
+    case '\\':
+      stream << "\\\\";
+      break;
+    case '\n':
+      stream << "\\n";
+      break;
+    case '\t':
+      stream << "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20u) {
+        stream << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+               << static_cast<int>(c) << std::dec;
+      } else {
+        stream << c;
+      }
+    }
+  }
+  return stream.str();
+}
+
+Str GetLatencyName(Latency const &latency) {
+  switch (latency) {
+  case Latency::LOAD:
+    return "load";
+  case Latency::DECODE:
+    return "decode";
+  case Latency::ENCODE:
+    return "encode";
+  default:
+    return "unknown";
+  }
+}
+
+Double ToMicroSec(SteadyClock::duration const &duration) {
+  return static_cast<Double>(DurationCast<NanoSec>(duration).count()) / 1000.0;
+}
+} // namespace
+
+Ulong Histogram::GetPercentile(Double const &percentile) const {
+  if (count == 0u) {
+    return 0u;
+  }
+  Ulong target = static_cast<Ulong>(percentile / 100.0 * count);
+  Ulong accumulated = 0u;
+  for (Uint i = 0u; i < NUM_HISTOGRAM_BUCKETS; ++i) {
+    accumulated += buckets[i];
+    if (accumulated > target) {
+      return i == 0u ? 0u : std::min<Ulong>(max, (Ulong(1u) << i) - 1u);
+    }
+  }
+  return max;
+}
+
+void Increment(Counter const &counter, Ulong const &amount) {
+  Add(GetRecorder().counters[static_cast<Uint>(counter)], amount);
+}
+
+void Record(Str const &name, Latency const &latency,
+            SteadyTimePoint const &start, SteadyTimePoint const &end) {
+  ThreadRecorder &recorder = GetRecorder();
+  Ulong duration = static_cast<Ulong>(
+      std::max<Long>(DurationCast<NanoSec>(end - start).count(), 0));
+  AtomicHistogram &histogram =
+      recorder.histograms[static_cast<Uint>(latency)];
+  Uint bucket = std::min<Uint>(std::bit_width(duration),
+                               NUM_HISTOGRAM_BUCKETS - 1u);
+  Add(histogram.buckets[bucket], 1u);
+  Add(histogram.count, 1u);
+  Add(histogram.total, duration);
+  if (duration > histogram.max.load(std::memory_order_relaxed)) {
+    histogram.max.store(duration, std::memory_order_relaxed);
+  }
+
+  if (GetRegistry().tracing.load(std::memory_order_relaxed)) {
+    LockGuard<Mutex> lock(recorder.mutex);
+    recorder.stamps.push_back({name, latency, recorder.thread, start, end});
+  }
+}
+
+void SetTracing(Bool const &enabled) { GetRegistry().tracing = enabled; }
+
+Bool IsTracing() { return GetRegistry().tracing.load(); }
+
+Snapshot GetSnapshot() {
+  Registry &registry = GetRegistry();
+  LockGuard<Mutex> lock(registry.mutex);
+  Snapshot snapshot;
+  for (auto const &recorder : registry.recorders) {
+    for (Uint i = 0u; i < NUM_COUNTERS; ++i) {
+      snapshot.counters[i] += recorder->counters[i].load();
+    }
+    for (Uint i = 0u; i < NUM_LATENCIES; ++i) {
+      AtomicHistogram const &source = recorder->histograms[i];
+      Histogram &target = snapshot.histograms[i];
+      for (Uint j = 0u; j < NUM_HISTOGRAM_BUCKETS; ++j) {
+        target.buckets[j] += source.buckets[j].load();
+      }
+      target.count += source.count.load();
+      target.total += source.total.load();
+      target.max = std::max(target.max, source.max.load());
+    }
+  }
+
+  // Reset() records a baseline instead of clearing the recorders, because
+  // their owners update them without read-modify-write operations.
+  for (Uint i = 0u; i < NUM_COUNTERS; ++i) {
+    snapshot.counters[i] -= registry.baseline.counters[i];
+  }
+  for (Uint i = 0u; i < NUM_LATENCIES; ++i) {
+    Histogram &target = snapshot.histograms[i];
+    Histogram const &baseline = registry.baseline.histograms[i];
+    for (Uint j = 0u; j < NUM_HISTOGRAM_BUCKETS; ++j) {
+      target.buckets[j] -= baseline.buckets[j];
+    }
+    target.count -= baseline.count;
+    target.total -= baseline.total;
+  }
+  return snapshot;
+}
+
+void Reset() {
+  Registry &registry = GetRegistry();
+  Snapshot current = GetSnapshot();
+  LockGuard<Mutex> lock(registry.mutex);
+  for (Uint i = 0u; i < NUM_COUNTERS; ++i) {
+    registry.baseline.counters[i] += current.counters[i];
+  }
+  for (Uint i = 0u; i < NUM_LATENCIES; ++i) {
+    Histogram &baseline = registry.baseline.histograms[i];
+    for (Uint j = 0u; j < NUM_HISTOGRAM_BUCKETS; ++j) {
+      baseline.buckets[j] += current.histograms[i].buckets[j];
+    }
+    baseline.count += current.histograms[i].count;
+    baseline.total += current.histograms[i].total;
+  }
+  for (auto const &recorder : registry.recorders) {
+    for (auto &histogram : recorder->histograms) {
+      histogram.max.store(0u, std::memory_order_relaxed);
+    }
+    LockGuard<Mutex> stampLock(recorder->mutex);
+    recorder->stamps.clear();
+  }
+  registry.origin = Now();
+}
+
+Str CreateTraceTimeLine() {
+  Registry &registry = GetRegistry();
+  Vec<TraceStamp> stamps;
+  SteadyTimePoint origin;
+  {
+    LockGuard<Mutex> lock(registry.mutex);
+    origin = registry.origin;
+    for (auto const &recorder : registry.recorders) {
+      LockGuard<Mutex> stampLock(recorder->mutex);
+      stamps.insert(stamps.end(), recorder->stamps.begin(),
+                    recorder->stamps.end());
+    }
+  }
+  std::sort(stamps.begin(), stamps.end(),
+            [](TraceStamp const &a, TraceStamp const &b) {
+              return a.start < b.start;
+            });
+
+  Stream stream;
+  stream << std::fixed << std::setprecision(3);
+  stream << "{\"traceEvents\":[";
+  for (Size i = 0; i < stamps.size(); ++i) {
+    TraceStamp const &stamp = stamps[i];
+    if (i != 0u) {
+      stream << ",";
+    }
+    stream << "\n{\"name\":\"" << EscapeJson(stamp.name) << "\",\"cat\":\""
+           << GetLatencyName(stamp.latency)
+           << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << stamp.thread
+           << ",\"ts\":" << ToMicroSec(stamp.start - origin)
+           << ",\"dur\":" << ToMicroSec(stamp.end - stamp.start) << "}";
+  }
+  stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return stream.str();
+}
+} // namespace TerreateIO::Instrument
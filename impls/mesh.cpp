@@ -0,0 +1,455 @@
+#include "../includes/mesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace TerreateIO::Mesh {
+using namespace TerreateIO::Defines;
+
+namespace {
+constexpr Float CACHE_DECAY_POWER = 1.5f;
+constexpr Float LAST_TRIANGLE_SCORE = 0.75f;
+constexpr Float VALENCE_BOOST_SCALE = 2.0f;
+constexpr Float VALENCE_BOOST_POWER = 0.5f;
+constexpr Float UNORM16_MAX = 65535.0f;
+constexpr Float SNORM16_MAX = 32767.0f;
+
+Float GetVertexScore(Int const &position, Uint const &remaining,
+                     Uint const &cacheSize) {
+  if (remaining == 0u) {
+    return -1.0f;
+  }
+  Float score = 0.0f;
+  if (position >= 0) {
+    // The vertices of the last triangle get a fixed score, so the optimizer
+    // does not prefer re-using them over the rest of the cache.
+    if (position < 3) {
+      score = LAST_TRIANGLE_SCORE;
+    } else {
+      Float scale = 1.0f / static_cast<Float>(cacheSize - 3u);
+      score = std::pow(1.0f - static_cast<Float>(position - 3) * scale,
+                       CACHE_DECAY_POWER);
+    }
+  }
+  return score + VALENCE_BOOST_SCALE * std::pow(static_cast<Float>(remaining),
+                                                -VALENCE_BOOST_POWER);
+}
+
+Float GetSign(Float const &value) { return value >= 0.0f ? 1.0f : -1.0f; }
+
+Double GetMilliSec(SteadyTimePoint const &start, SteadyTimePoint const &end) {
+  return static_cast<Double>(DurationCast<NanoSec>(end - start).count()) /
+         1000000.0;
+}
+
+void CheckIndices(Vec<Uint> const &indices, Size const &vertexCount) {
+  if (indices.size() % 3u != 0u) {
+    throw Exception::MeshException("Index count is not a multiple of 3");
+  }
+  for (Uint index : indices) {
+    if (index >= vertexCount) {
+      throw Exception::MeshException("Index out of range");
+    }
+  }
+}
+} // namespace
+
+Ushort EncodeHalf(Float const &value) {
+  Uint bits = std::bit_cast<Uint>(value);
+  Uint sign = (bits >> 16) & 0x8000u;
+  Uint exponent = (bits >> 23) & 0xFFu;
+  Uint mantissa = bits & 0x7FFFFFu;
+  if (exponent == 0xFFu) {
+    return static_cast<Ushort>(sign | 0x7C00u | (mantissa != 0u ? 0x200u : 0u));
+  }
+
+  Int halfExponent = static_cast<Int>(exponent) - 127 + 15;
+  if (halfExponent >= 0x1F) {
+    return static_cast<Ushort>(sign | 0x7C00u);
+  }
+  if (halfExponent <= 0) {
+    if (halfExponent < -10) {
+      return static_cast<Ushort>(sign);
+    }
+    // Subnormal half, rounded to nearest even.
+    mantissa |= 0x800000u;
+    Uint shift = static_cast<Uint>(14 - halfExponent);
+    Uint half = mantissa >> shift;
+    Uint rest = mantissa & ((1u << shift) - 1u);
+    Uint midpoint = 1u << (shift - 1u);
+    if (rest > midpoint || (rest == midpoint && (half & 1u) != 0u)) {
+      ++half;
+    }
+    return static_cast<Ushort>(sign | half);
+  }
+
+  Uint half = (static_cast<Uint>(halfExponent) << 10) | (mantissa >> 13);
+  Uint rest = mantissa & 0x1FFFu;
+  // A carry out of the mantissa correctly bumps the exponent.
+  if (rest > 0x1000u || (rest == 0x1000u && (half & 1u) != 0u)) {
+    ++half;
+  }
+  return static_cast<Ushort>(sign | half);
+}
+
+Float DecodeHalf(Ushort const &value) {
+  Uint sign = static_cast<Uint>(value & 0x8000u) << 16;
+  Uint exponent = (value >> 10) & 0x1Fu;
+  Uint mantissa = value & 0x3FFu;
+  if (exponent == 0u) {
+    Float subnormal = std::ldexp(static_cast<Float>(mantissa), -24);
+    return sign != 0u ? -subnormal : subnormal;
+  }
+  if (exponent == 0x1Fu) {
+    return std::bit_cast<Float>(sign | 0x7F800000u | (mantissa << 13));
+  }
+  return std::bit_cast<Float>(sign | ((exponent + 112u) << 23) |
+                              (mantissa << 13));
+}
+
+void EncodeOctahedral(Float const *normal, Short *encoded) {
+  Float length =
+      std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+  if (length == 0.0f) {
+    encoded[0] = 0;
+    encoded[1] = 0;
+    return;
+  }
+  Float x = normal[0] / length;
+  Float y = normal[1] / length;
+  if (normal[2] < 0.0f) {
+    // Fold the lower hemisphere over the diagonals.
+    Float foldedX = (1.0f - std::abs(y)) * GetSign(x);
+    Float foldedY = (1.0f - std::abs(x)) * GetSign(y);
+    x = foldedX;
+    y = foldedY;
+  }
+  encoded[0] =
+      static_cast<Short>(std::round(std::clamp(x, -1.0f, 1.0f) * SNORM16_MAX));
+  encoded[1] =
+      static_cast<Short>(std::round(std::clamp(y, -1.0f, 1.0f) * SNORM16_MAX));
+}
+
+void DecodeOctahedral(Short const *encoded, Float *normal) {
+  Float x = std::max(static_cast<Float>(encoded[0]) / SNORM16_MAX, -1.0f);
+  Float y = std::max(static_cast<Float>(encoded[1]) / SNORM16_MAX, -1.0f);
+  Float z = 1.0f - std::abs(x) - std::abs(y);
+  Float fold = std::max(-z, 0.0f);
+  x -= fold * GetSign(x);
+  y -= fold * GetSign(y);
+  Float length = std::sqrt(x * x + y * y + z * z);
+  normal[0] = x / length;
+  normal[1] = y / length;
+  normal[2] = z / length;
+}
+
+Double GetACMR(Vec<Uint> const &indices, Size const &vertexCount,
+               Uint const &cacheSize) {
+  CheckIndices(indices, vertexCount);
+  if (indices.empty()) {
+    return 0.0;
+  }
+  // A vertex is cached while fewer than `cacheSize` misses happened since it
+  // was inserted.
+  Vec<Size> insertions(vertexCount, 0u);
+  Size time = cacheSize + 1u;
+  Size misses = 0u;
+  for (Uint index : indices) {
+    if (time - insertions[index] > cacheSize) {
+      insertions[index] = time++;
+      ++misses;
+    }
+  }
+  return static_cast<Double>(misses) / static_cast<Double>(indices.size() / 3u);
+}
+
+void OptimizeVertexCache(Vec<Uint> &indices, Size const &vertexCount,
+                         Uint const &cacheSize) {
+  if (cacheSize < 4u) {
+    throw Exception::MeshException("Vertex cache size must be at least 4");
+  }
+  CheckIndices(indices, vertexCount);
+  Size triangleCount = indices.size() / 3u;
+
+  // Triangles not yet emitted, grouped by vertex.
+  Vec<Uint> remaining(vertexCount, 0u);
+  for (Uint index : indices) {
+    ++remaining[index];
+  }
+  Vec<Size> offsets(vertexCount + 1u, 0u);
+  for (Size i = 0; i < vertexCount; ++i) {
+    offsets[i + 1u] = offsets[i] + remaining[i];
+  }
+  Vec<Uint> adjacency(indices.size());
+  {
+    Vec<Size> fill(offsets.begin(), offsets.end() - 1);
+    for (Size i = 0; i < indices.size(); ++i) {
+      adjacency[fill[indices[i]]++] = static_cast<Uint>(i / 3u);
+    }
+  }
+
+  Vec<Float> vertexScores(vertexCount);
+  for (Size i = 0; i < vertexCount; ++i) {
+    vertexScores[i] = GetVertexScore(-1, remaining[i], cacheSize);
+  }
+  Vec<Float> triangleScores(triangleCount);
+  Vec<Bool> emitted(triangleCount, false);
+  Size best = 0u;
+  Bool found = triangleCount > 0u;
+  for (Size i = 0; i < triangleCount; ++i) {
+    triangleScores[i] = vertexScores[indices[i * 3u]] +
+                        vertexScores[indices[i * 3u + 1u]] +
+                        vertexScores[indices[i * 3u + 2u]];
+    if (triangleScores[i] > triangleScores[best]) {
+      best = i;
+    }
+  }
+
+  Vec<Uint> cache;
+  Vec<Uint> next;
+  cache.reserve(cacheSize + 3u);
+  next.reserve(cacheSize + 3u);
+  Vec<Uint> output;
+  output.reserve(indices.size());
+  Size cursor = 0u;
+  for (Size count = 0u; count < triangleCount; ++count) {
+    if (!found) {
+      // Dead end: no cached vertex has triangles left.
+      while (emitted[cursor]) {
+        ++cursor;
+      }
+      best = cursor;
+    }
+    emitted[best] = true;
+
+    next.clear();
+    for (Size k = 0; k < 3u; ++k) {
+      Uint vertex = indices[best * 3u + k];
+      output.push_back(vertex);
+      Uint *begin = adjacency.data() + offsets[vertex];
+      Uint *end = begin + remaining[vertex];
+      *std::find(begin, end, static_cast<Uint>(best)) = *(end - 1);
+      --remaining[vertex];
+      if (std::find(next.begin(), next.end(), vertex) == next.end()) {
+        next.push_back(vertex);
+      }
+    }
+    Size added = next.size();
+    for (Uint vertex : cache) {
+      if (std::find(next.begin(), next.begin() + added, vertex) ==
+          next.begin() + added) {
+        next.push_back(vertex);
+      }
+    }
+
+    // Vertices pushed past the cache size are evicted.
+    for (Size i = 0; i < next.size(); ++i) {
+      Uint vertex = next[i];
+      Int position = i < cacheSize ? static_cast<Int>(i) : -1;
+      Float score = GetVertexScore(position, remaining[vertex], cacheSize);
+      Float delta = score - vertexScores[vertex];
+      vertexScores[vertex] = score;
+      Size begin = offsets[vertex];
+      for (Size j = begin; j < begin + remaining[vertex]; ++j) {
+        triangleScores[adjacency[j]] += delta;
+      }
+    }
+    next.resize(std::min<Size>(next.size(), cacheSize));
+    cache.swap(next);
+
+    found = false;
+    Float bestScore = -std::numeric_limits<Float>::infinity();
+    for (Uint vertex : cache) {
+      Size begin = offsets[vertex];
+      for (Size j = begin; j < begin + remaining[vertex]; ++j) {
+        if (triangleScores[adjacency[j]] > bestScore) {
+          bestScore = triangleScores[adjacency[j]];
+          best = adjacency[j];
+          found = true;
+        }
+      }
+    }
+  }
+  indices.swap(output);
+}
+
+void OptimizeVertexFetch(MeshData &mesh) {
+  constexpr Uint UNUSED = std::numeric_limits<Uint>::max();
+  // Non-indexed meshes are drawn in vertex order.
+  if (mesh.indices.empty()) {
+    return;
+  }
+  CheckIndices(mesh.indices, mesh.vertices.size());
+  Vec<Uint> remap(mesh.vertices.size(), UNUSED);
+  Vec<Vertex> vertices;
+  vertices.reserve(mesh.vertices.size());
+  for (Uint &index : mesh.indices) {
+    if (remap[index] == UNUSED) {
+      remap[index] = static_cast<Uint>(vertices.size());
+      vertices.push_back(mesh.vertices[index]);
+    }
+    index = remap[index];
+  }
+  mesh.vertices.swap(vertices);
+}
+
+ExportMetrics ExportMesh(MeshData const &mesh, Buffer::WriteBuffer &buffer,
+                         ExportOptions const &options) {
+  TIO_SCOPE("ExportMesh", ENCODE);
+  if (mesh.vertices.size() > std::numeric_limits<Uint>::max() ||
+      mesh.indices.size() > std::numeric_limits<Uint>::max()) {
+    throw Exception::MeshException("Mesh is too large");
+  }
+  ExportMetrics metrics;
+  metrics.rawSize = mesh.vertices.size() * sizeof(Vertex) +
+                    mesh.indices.size() * sizeof(Uint);
+
+  SteadyTimePoint start = Now();
+  MeshData optimized = mesh;
+  metrics.acmrBefore =
+      GetACMR(optimized.indices, optimized.vertices.size(), options.cacheSize);
+  if (options.optimizeVertexCache) {
+    OptimizeVertexCache(optimized.indices, optimized.vertices.size(),
+                        options.cacheSize);
+  }
+  if (options.optimizeVertexFetch) {
+    OptimizeVertexFetch(optimized);
+  }
+  metrics.acmrAfter =
+      GetACMR(optimized.indices, optimized.vertices.size(), options.cacheSize);
+  SteadyTimePoint optimizedTime = Now();
+
+  MeshHeader header = {};
+  header.magic = MESH_MAGIC;
+  header.version = MESH_VERSION;
+  header.vertexCount = static_cast<Uint>(optimized.vertices.size());
+  header.indexCount = static_cast<Uint>(optimized.indices.size());
+  header.vertexStride = options.quantize ? sizeof(QuantizedVertex)
+                                         : sizeof(Vertex);
+  if (options.quantize) {
+    header.flags |= MESH_FLAG_QUANTIZED;
+  }
+  // Index 0xFFFF stays usable, primitive restart is not used.
+  Bool narrow = options.narrowIndices && optimized.vertices.size() <= 0x10000u;
+  if (narrow) {
+    header.flags |= MESH_FLAG_SHORT_INDICES;
+  }
+  if (!optimized.vertices.empty()) {
+    for (Size i = 0; i < 3u; ++i) {
+      header.boundsMin[i] = std::numeric_limits<Float>::max();
+      header.boundsMax[i] = std::numeric_limits<Float>::lowest();
+    }
+  }
+  for (auto const &vertex : optimized.vertices) {
+    for (Size i = 0; i < 3u; ++i) {
+      header.boundsMin[i] = std::min(header.boundsMin[i], vertex.position[i]);
+      header.boundsMax[i] = std::max(header.boundsMax[i], vertex.position[i]);
+    }
+  }
+
+  Size begin = buffer.GetSize();
+  buffer.Write(header);
+  if (options.quantize) {
+    Float scale[3];
+    for (Size i = 0; i < 3u; ++i) {
+      Float extent = header.boundsMax[i] - header.boundsMin[i];
+      scale[i] = extent > 0.0f ? UNORM16_MAX / extent : 0.0f;
+    }
+    Vec<QuantizedVertex> encoded(optimized.vertices.size());
+    for (Size i = 0; i < optimized.vertices.size(); ++i) {
+      Vertex const &vertex = optimized.vertices[i];
+      QuantizedVertex &target = encoded[i];
+      for (Size j = 0; j < 3u; ++j) {
+        Float value = (vertex.position[j] - header.boundsMin[j]) * scale[j];
+        target.position[j] = static_cast<Ushort>(
+            std::clamp(value, 0.0f, UNORM16_MAX) + 0.5f);
+      }
+      target.position[3] = 0u;
+      EncodeOctahedral(vertex.normal, target.normal);
+      target.uv[0] = EncodeHalf(vertex.uv[0]);
+      target.uv[1] = EncodeHalf(vertex.uv[1]);
+    }
+    buffer.Write((Byte const *)encoded.data(),
+                 encoded.size() * sizeof(QuantizedVertex));
+  } else {
+    buffer.Write((Byte const *)optimized.vertices.data(),
+                 optimized.vertices.size() * sizeof(Vertex));
+  }
+  if (narrow) {
+    Vec<Ushort> narrowed(optimized.indices.begin(), optimized.indices.end());
+    buffer.Write((Byte const *)narrowed.data(),
+                 narrowed.size() * sizeof(Ushort));
+  } else {
+    buffer.Write((Byte const *)optimized.indices.data(),
+                 optimized.indices.size() * sizeof(Uint));
+  }
+  SteadyTimePoint end = Now();
+
+  metrics.exportedSize = buffer.GetSize() - begin;
+  metrics.optimizeMilliSec = GetMilliSec(start, optimizedTime);
+  metrics.encodeMilliSec = GetMilliSec(optimizedTime, end);
+  return metrics;
+}
+
+MeshData ImportMesh(Buffer::ReadBuffer &buffer) {
+  TIO_SCOPE("ImportMesh", DECODE);
+  MeshHeader header = buffer.Read<MeshHeader>();
+  if (header.magic != MESH_MAGIC || header.version != MESH_VERSION) {
+    throw Exception::MeshException("Invalid mesh header");
+  }
+  Bool quantized = (header.flags & MESH_FLAG_QUANTIZED) != 0u;
+  Bool narrow = (header.flags & MESH_FLAG_SHORT_INDICES) != 0u;
+  Size stride = quantized ? sizeof(QuantizedVertex) : sizeof(Vertex);
+  if (header.vertexStride != stride || header.indexCount % 3u != 0u) {
+    throw Exception::MeshException("Invalid mesh layout");
+  }
+  Size vertexSize = header.vertexCount * stride;
+  Size indexSize =
+      header.indexCount * (narrow ? sizeof(Ushort) : sizeof(Uint));
+  if (buffer.GetSize() - buffer.GetPosition() < vertexSize + indexSize) {
+    throw Exception::MeshException("Mesh data out of bounds");
+  }
+
+  // Bounds are checked once above, so the arrays are copied directly instead
+  // of going through per-element reads.
+  Byte const *data = buffer.GetData() + buffer.GetPosition();
+  MeshData mesh;
+  mesh.vertices.resize(header.vertexCount);
+  if (quantized) {
+    Float scale[3];
+    for (Size i = 0; i < 3u; ++i) {
+      scale[i] = (header.boundsMax[i] - header.boundsMin[i]) / UNORM16_MAX;
+    }
+    for (Size i = 0; i < header.vertexCount; ++i) {
+      QuantizedVertex source;
+      std::memcpy(&source, data + i * stride, stride);
+      Vertex &vertex = mesh.vertices[i];
+      for (Size j = 0; j < 3u; ++j) {
+        vertex.position[j] =
+            header.boundsMin[j] + source.position[j] * scale[j];
+      }
+      DecodeOctahedral(source.normal, vertex.normal);
+      vertex.uv[0] = DecodeHalf(source.uv[0]);
+      vertex.uv[1] = DecodeHalf(source.uv[1]);
+    }
+  } else if (vertexSize > 0u) {
+    std::memcpy(mesh.vertices.data(), data, vertexSize);
+  }
+
+  data += vertexSize;
+  mesh.indices.resize(header.indexCount);
+  if (narrow) {
+    for (Size i = 0; i < header.indexCount; ++i) {
+      Ushort index;
+      std::memcpy(&index, data + i * sizeof(Ushort), sizeof(Ushort));
+      mesh.indices[i] = index;
+    }
+  } else if (indexSize > 0u) {
+    std::memcpy(mesh.indices.data(), data, indexSize);
+  }
+  CheckIndices(mesh.indices, mesh.vertices.size());
+  buffer.Skip(vertexSize + indexSize);
+  return mesh;
+}
+} // namespace TerreateIO::Mesh
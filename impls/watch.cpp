@@ -0,0 +1,315 @@
+#include "../includes/watch.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <filesystem>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace TerreateIO::Watch {
+using namespace TerreateIO::Defines;
+namespace fs = std::filesystem;
+
+namespace {
+// Saving in place ends with IN_CLOSE_WRITE, saving through a temporary file
+// ends with IN_MOVED_TO. Deleting a source keeps the last imported version.
+constexpr Uint WATCH_EVENT_MASK = IN_CLOSE_WRITE | IN_MOVED_TO;
+
+Str NormalizePath(Str const &path) {
+  return fs::absolute(fs::path(path)).lexically_normal().string();
+}
+
+Str GetDirectory(Str const &path) {
+  return fs::path(path).parent_path().string();
+}
+} // namespace
+
+FileWatcher::FileWatcher(ChangeCallback const &callback,
+                         MilliSec const &debounce)
+    : mDebounce(debounce), mCallback(callback) {
+  mDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (mDescriptor < 0) {
+    throw Exception::IOException("Failed to initialize inotify.");
+  }
+  mWakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (mWakeup < 0) {
+    close(mDescriptor);
+    throw Exception::IOException("Failed to create wakeup event.");
+  }
+  mThread = Thread(&FileWatcher::Worker, this);
+}
+
+FileWatcher::~FileWatcher() {
+  mRunning = false;
+  Ulong signal = 1u;
+  ssize_t written = write(mWakeup, &signal, sizeof(signal));
+  (void)written;
+  if (mThread.joinable()) {
+    mThread.join();
+  }
+  close(mWakeup);
+  close(mDescriptor);
+}
+
+Bool FileWatcher::ReadEvents(Set<Str> &pending) {
+  Bool changed = false;
+  alignas(inotify_event) char buffer[4096];
+  while (true) {
+    ssize_t length = read(mDescriptor, buffer, sizeof(buffer));
+    if (length <= 0) {
+      break;
+    }
+
+    LockGuard<Mutex> lock(mMutex);
+    for (char const *cursor = buffer; cursor < buffer + length;) {
+      auto const *event = reinterpret_cast<inotify_event const *>(cursor);
+      cursor += sizeof(inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        // Events were dropped, so every watched file may have changed.
+        pending.insert(mFiles.begin(), mFiles.end());
+        changed = true;
+        continue;
+      }
+      auto directory = mDirectories.find(event->wd);
+      if (directory == mDirectories.end()) {
+        continue;
+      }
+      if (event->mask & IN_IGNORED) {
+        mWatches.erase(directory->second);
+        mDirectories.erase(directory);
+        continue;
+      }
+      if (event->len == 0u) {
+        continue;
+      }
+      Str path = (fs::path(directory->second) / event->name).string();
+      if (mFiles.contains(path)) {
+        pending.insert(path);
+        changed = true;
+      }
+    }
+  }
+  return changed;
+}
+
+void FileWatcher::Worker() {
+  Set<Str> pending;
+  SteadyTimePoint first;
+  SteadyTimePoint last;
+  while (mRunning.load()) {
+    int timeout = -1;
+    if (!pending.empty()) {
+      // Wait until the events settle, but never longer than WATCH_MAX_DELAY
+      // after the first one, so files written continuously still reload.
+      SteadyTimePoint deadline =
+          std::min(last + mDebounce, first + WATCH_MAX_DELAY);
+      auto remaining = chrono::ceil<MilliSec>(deadline - Now()).count();
+      timeout = static_cast<int>(std::max<Long>(remaining, 0));
+    }
+
+    pollfd descriptors[2] = {{mDescriptor, POLLIN, 0}, {mWakeup, POLLIN, 0}};
+    int result = poll(descriptors, 2, timeout);
+    if (result < 0 && errno != EINTR) {
+      break;
+    }
+    if (descriptors[1].revents & POLLIN) {
+      break;
+    }
+    if (descriptors[0].revents & POLLIN) {
+      Bool idle = pending.empty();
+      if (this->ReadEvents(pending)) {
+        last = Now();
+        if (idle) {
+          first = last;
+        }
+      }
+      continue;
+    }
+
+    if (!pending.empty()) {
+      Vec<Str> changed(pending.begin(), pending.end());
+      pending.clear();
+      try {
+        mCallback(changed);
+      } catch (...) {
+        // A failing callback must not stop watching.
+      }
+    }
+  }
+}
+
+void FileWatcher::Watch(Str const &path) {
+  Str file = NormalizePath(path);
+  Str directory = GetDirectory(file);
+  LockGuard<Mutex> lock(mMutex);
+  if (mFiles.contains(file)) {
+    return;
+  }
+  if (!mWatches.contains(directory)) {
+    int watch =
+        inotify_add_watch(mDescriptor, directory.c_str(), WATCH_EVENT_MASK);
+    if (watch < 0) {
+      throw Exception::IOException("Failed to watch directory: " + directory);
+    }
+    mWatches[directory] = watch;
+    mDirectories[watch] = directory;
+  }
+  mFiles.insert(file);
+  ++mWatchCounts[directory];
+}
+
+void FileWatcher::Unwatch(Str const &path) {
+  Str file = NormalizePath(path);
+  Str directory = GetDirectory(file);
+  LockGuard<Mutex> lock(mMutex);
+  if (mFiles.erase(file) == 0u || --mWatchCounts[directory] > 0u) {
+    return;
+  }
+  mWatchCounts.erase(directory);
+  auto watch = mWatches.find(directory);
+  if (watch != mWatches.end()) {
+    inotify_rm_watch(mDescriptor, watch->second);
+    mDirectories.erase(watch->second);
+    mWatches.erase(watch);
+  }
+}
+
+HotReloader::HotReloader(MilliSec const &debounce)
+    : mWatcher([this](Vec<Str> const &paths) { this->OnChange(paths); },
+               debounce) {}
+
+std::shared_ptr<HotReloader::Asset>
+HotReloader::FindAsset(Str const &key) const {
+  LockGuard<Mutex> lock(mMutex);
+  auto asset = mAssets.find(key);
+  return asset == mAssets.end() ? nullptr : asset->second;
+}
+
+void HotReloader::Release(Asset const &asset) {
+  for (auto const &source : asset.sources) {
+    auto dependents = mDependents.find(source);
+    if (dependents == mDependents.end()) {
+      continue;
+    }
+    dependents->second.erase(asset.key);
+    if (dependents->second.empty()) {
+      mDependents.erase(dependents);
+      mWatcher.Unwatch(source);
+    }
+  }
+}
+
+void HotReloader::OnChange(Vec<Str> const &paths) {
+  Vec<std::shared_ptr<Asset>> affected;
+  ReloadListener listener;
+  {
+    LockGuard<Mutex> lock(mMutex);
+    Set<Str> keys;
+    for (auto const &path : paths) {
+      auto dependents = mDependents.find(path);
+      if (dependents == mDependents.end()) {
+        continue;
+      }
+      for (auto const &key : dependents->second) {
+        if (keys.insert(key).second) {
+          affected.push_back(mAssets[key]);
+        }
+      }
+    }
+    listener = mListener;
+  }
+
+  for (auto const &asset : affected) {
+    Bool success = true;
+    {
+      LockGuard<Mutex> reload(asset->mutex);
+      try {
+        TIO_SCOPE(asset->key, DECODE);
+        auto decoded = std::make_shared<Buffer::ReadBuffer>();
+        asset->loader(*decoded);
+        asset->Store(decoded);
+        ++asset->version;
+      } catch (...) {
+        success = false;
+      }
+    }
+    if (listener) {
+      listener(asset->key, success);
+    }
+  }
+}
+
+Cache::SharedBuffer HotReloader::Track(Str const &key,
+                                       Vec<Str> const &sources,
+                                       Cache::Loader const &loader) {
+  this->Untrack(key);
+  auto asset = std::make_shared<Asset>();
+  asset->key = key;
+  asset->loader = loader;
+  for (auto const &source : sources) {
+    asset->sources.push_back(NormalizePath(source));
+  }
+
+  // The asset is registered and watched before the initial import, so edits
+  // made while importing are picked up by a reimport right after it.
+  LockGuard<Mutex> reload(asset->mutex);
+  try {
+    {
+      LockGuard<Mutex> lock(mMutex);
+      mAssets[key] = asset;
+      for (auto const &source : asset->sources) {
+        Set<Str> &dependents = mDependents[source];
+        if (dependents.empty()) {
+          mWatcher.Watch(source);
+        }
+        dependents.insert(key);
+      }
+    }
+
+    TIO_SCOPE(key, DECODE);
+    auto decoded = std::make_shared<Buffer::ReadBuffer>();
+    loader(*decoded);
+    asset->Store(decoded);
+    asset->version = 1u;
+    return decoded;
+  } catch (...) {
+    LockGuard<Mutex> lock(mMutex);
+    auto registered = mAssets.find(key);
+    // A concurrent Untrack or Track already released the sources otherwise.
+    if (registered != mAssets.end() && registered->second == asset) {
+      mAssets.erase(registered);
+      this->Release(*asset);
+    }
+    throw;
+  }
+}
+
+void HotReloader::Untrack(Str const &key) {
+  LockGuard<Mutex> lock(mMutex);
+  auto asset = mAssets.find(key);
+  if (asset == mAssets.end()) {
+    return;
+  }
+  this->Release(*asset->second);
+  mAssets.erase(asset);
+}
+
+Cache::SharedBuffer HotReloader::Get(Str const &key) const {
+  std::shared_ptr<Asset> asset = this->FindAsset(key);
+  return asset == nullptr ? nullptr : asset->Load();
+}
+
+Ulong HotReloader::GetVersion(Str const &key) const {
+  std::shared_ptr<Asset> asset = this->FindAsset(key);
+  return asset == nullptr ? 0u : asset->version.load();
+}
+
+void HotReloader::SetListener(ReloadListener const &listener) {
+  LockGuard<Mutex> lock(mMutex);
+  mListener = listener;
+}
+} // namespace TerreateIO::Watch
@@ -0,0 +1,353 @@
+#ifndef __TERREATEIO_ASYNC_HPP__
+#define __TERREATEIO_ASYNC_HPP__
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+
+#include "buffer.hpp"
+#include "defines.hpp"
+#include "exceptions.hpp"
+
+namespace TerreateIO::Async {
+using namespace TerreateIO::Defines;
+
+constexpr Uint ASYNC_DEFAULT_IO_WORKERS = 4u;
+constexpr Size ASYNC_DEFAULT_CHUNK_SIZE = 64u * 1024u;
+
+template <typename T> class AsyncTask;
+
+namespace Detail {
+class PromiseBase {
+private:
+  std::coroutine_handle<> mContinuation;
+  std::exception_ptr mError;
+
+public:
+  struct FinalAwaiter {
+    Bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+      auto continuation = handle.promise().mContinuation;
+      return continuation ? continuation : std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+  };
+
+public:
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() { mError = std::current_exception(); }
+
+  void SetContinuation(std::coroutine_handle<> const &continuation) {
+    mContinuation = continuation;
+  }
+  void Rethrow() const {
+    if (mError) {
+      std::rethrow_exception(mError);
+    }
+  }
+};
+
+template <typename T> class Promise : public PromiseBase {
+private:
+  std::optional<T> mValue;
+
+public:
+  AsyncTask<T> get_return_object();
+  template <typename U> void return_value(U &&value) {
+    mValue.emplace(std::forward<U>(value));
+  }
+
+  T TakeValue() {
+    this->Rethrow();
+    return std::move(*mValue);
+  }
+};
+
+template <> class Promise<void> : public PromiseBase {
+public:
+  AsyncTask<void> get_return_object();
+  void return_void() const noexcept {}
+
+  void TakeValue() const { this->Rethrow(); }
+};
+} // namespace Detail
+
+// Lazily started coroutine. Awaiting it starts the body and resumes the
+// awaiting coroutine when the body finishes.
+template <typename T> class AsyncTask {
+public:
+  typedef Detail::Promise<T> promise_type;
+
+private:
+  std::coroutine_handle<promise_type> mHandle;
+
+private:
+  AsyncTask(AsyncTask const &) = delete;
+  AsyncTask &operator=(AsyncTask const &) = delete;
+
+public:
+  explicit AsyncTask(std::coroutine_handle<promise_type> const &handle)
+      : mHandle(handle) {}
+  AsyncTask(AsyncTask &&other) noexcept : mHandle(other.mHandle) {
+    other.mHandle = nullptr;
+  }
+  ~AsyncTask() {
+    if (mHandle) {
+      mHandle.destroy();
+    }
+  }
+
+  Bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<>
+  await_suspend(std::coroutine_handle<> const &continuation) {
+    mHandle.promise().SetContinuation(continuation);
+    return mHandle;
+  }
+  T await_resume() { return mHandle.promise().TakeValue(); }
+
+  AsyncTask &operator=(AsyncTask &&other) noexcept {
+    if (this != &other) {
+      if (mHandle) {
+        mHandle.destroy();
+      }
+      mHandle = other.mHandle;
+      other.mHandle = nullptr;
+    }
+    return *this;
+  }
+};
+
+template <typename T> AsyncTask<T> Detail::Promise<T>::get_return_object() {
+  return AsyncTask<T>(
+      std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline AsyncTask<void> Detail::Promise<void>::get_return_object() {
+  return AsyncTask<void>(
+      std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+// Resumes coroutines on the threads calling Run(). Blocking file I/O is
+// handed to a small pool of I/O workers, and the suspended coroutine is
+// queued again once the operation completes, so no loop thread ever waits on
+// the disk.
+class EventLoop : public TerreateObjectBase {
+private:
+  Queue<std::coroutine_handle<>> mReady;
+  Mutex mMutex;
+  ConditionVariable mCV;
+  Uint mActive = 0u;
+  Bool mStop = false;
+  std::exception_ptr mError;
+  TerreateCore::Executor::Executor mIOExecutor;
+
+private:
+  EventLoop(EventLoop const &) = delete;
+  EventLoop &operator=(EventLoop const &) = delete;
+
+  void Complete(std::exception_ptr const &error);
+
+public:
+  EventLoop(Uint const &numIOWorkers = ASYNC_DEFAULT_IO_WORKERS)
+      : mIOExecutor(numIOWorkers) {}
+  ~EventLoop() override = default;
+
+  // Queues `handle` to be resumed by one of the loop threads.
+  void Post(std::coroutine_handle<> const &handle);
+  // Runs `operation` on an I/O worker and posts `handle` afterwards.
+  void Submit(Function<void()> const &operation,
+              std::coroutine_handle<> const &handle);
+  // Starts `task` on the loop. The first exception escaping a spawned task
+  // is rethrown from Run().
+  void Spawn(AsyncTask<void> &&task);
+  // Resumes coroutines until every spawned task finished or Stop() is called.
+  // Several threads may run the same loop.
+  void Run();
+  void Stop();
+
+  template <typename T> T RunUntilComplete(AsyncTask<T> &&task);
+};
+
+class IOOperation {
+private:
+  EventLoop &mLoop;
+  Function<Long()> mOperation;
+  Long mResult = 0;
+  int mError = 0;
+
+public:
+  IOOperation(EventLoop &loop, Function<Long()> const &operation)
+      : mLoop(loop), mOperation(operation) {}
+
+  Bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> const &handle);
+  Size await_resume() const;
+};
+
+enum class OpenMode { READ, WRITE, READ_WRITE };
+
+class AsyncFile : public TerreateObjectBase {
+private:
+  EventLoop &mLoop;
+  Str mPath;
+  int mDescriptor = -1;
+
+  friend class AsyncReader;
+
+private:
+  AsyncFile(AsyncFile const &) = delete;
+  AsyncFile &operator=(AsyncFile const &) = delete;
+
+  // Blocking primitives executed on the I/O workers.
+  Long ReadFully(Byte *data, Size const &size, Size const &offset) const;
+  Long WriteFully(Byte const *data, Size const &size,
+                  Size const &offset) const;
+
+public:
+  AsyncFile(EventLoop &loop, Str const &path,
+            OpenMode const &mode = OpenMode::READ);
+  ~AsyncFile() override;
+
+  EventLoop &GetLoop() { return mLoop; }
+  Str const &GetPath() const { return mPath; }
+  Size GetSize() const;
+
+  // Reads until `size` bytes are read or the end of the file is reached and
+  // resumes with the number of bytes read.
+  IOOperation ReadAt(Byte *data, Size const &size, Size const &offset);
+  IOOperation WriteAt(Byte const *data, Size const &size, Size const &offset);
+  AsyncTask<Buffer::ReadBuffer> LoadAsync();
+};
+
+class AsyncReader;
+
+template <typename T> class ReadAwaiter {
+private:
+  AsyncReader &mReader;
+
+public:
+  ReadAwaiter(AsyncReader &reader) : mReader(reader) {}
+
+  Bool await_ready() const;
+  void await_suspend(std::coroutine_handle<> const &handle);
+  T await_resume();
+};
+
+// Streams a file through a chunk sized ReadBuffer. Reads that fit into the
+// current chunk complete without suspending.
+class AsyncReader : public TerreateObjectBase {
+private:
+  AsyncFile &mFile;
+  Buffer::ReadBuffer mChunk;
+  Size mChunkSize = ASYNC_DEFAULT_CHUNK_SIZE;
+  Size mOffset = 0u;
+  Byte *mPending = nullptr;
+  Size mPendingSize = 0u;
+  Long mResult = 0;
+  int mError = 0;
+
+  template <typename T> friend class ReadAwaiter;
+
+private:
+  AsyncReader(AsyncReader const &) = delete;
+  AsyncReader &operator=(AsyncReader const &) = delete;
+
+  Size GetAvailable() const {
+    return mChunk.GetSize() - mChunk.GetPosition();
+  }
+  void Refill(Size const &size, std::coroutine_handle<> const &handle);
+  void FinishRefill();
+
+public:
+  AsyncReader(AsyncFile &file,
+              Size const &chunkSize = ASYNC_DEFAULT_CHUNK_SIZE)
+      : mFile(file), mChunkSize(chunkSize) {}
+  ~AsyncReader() override;
+
+  template <typename T> ReadAwaiter<T> ReadAsync() {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "ReadAsync requires a trivially copyable type");
+    return ReadAwaiter<T>(*this);
+  }
+};
+
+// Collects writes in a WriteBuffer and writes them out on FlushAsync().
+class AsyncWriter : public TerreateObjectBase {
+private:
+  AsyncFile &mFile;
+  Buffer::WriteBuffer mBuffer;
+  Size mOffset = 0u;
+
+private:
+  AsyncWriter(AsyncWriter const &) = delete;
+  AsyncWriter &operator=(AsyncWriter const &) = delete;
+
+public:
+  AsyncWriter(AsyncFile &file, Size const &offset = 0u)
+      : mFile(file), mOffset(offset) {}
+  ~AsyncWriter() override = default;
+
+  void Write(Str const &data) { mBuffer.Write(data); }
+  void Write(Byte const *data, Size const &size) { mBuffer.Write(data, size); }
+  template <typename T> void Write(T const &data) { mBuffer.Write(data); }
+
+  AsyncTask<void> FlushAsync();
+};
+
+template <typename T> T EventLoop::RunUntilComplete(AsyncTask<T> &&task) {
+  // The task outlives this call if Stop() ends the loop first, so the result
+  // is shared with it.
+  if constexpr (std::is_void_v<T>) {
+    auto done = std::make_shared<Bool>(false);
+    auto wrapper = [](AsyncTask<void> task,
+                      std::shared_ptr<Bool> done) -> AsyncTask<void> {
+      co_await task;
+      *done = true;
+    };
+    this->Spawn(wrapper(std::move(task), done));
+    this->Run();
+    if (!*done) {
+      throw Exception::IOException("Event loop stopped before completion");
+    }
+  } else {
+    auto result = std::make_shared<std::optional<T>>();
+    auto wrapper =
+        [](AsyncTask<T> task,
+           std::shared_ptr<std::optional<T>> result) -> AsyncTask<void> {
+      result->emplace(co_await task);
+    };
+    this->Spawn(wrapper(std::move(task), result));
+    this->Run();
+    if (!*result) {
+      throw Exception::IOException("Event loop stopped before completion");
+    }
+    return std::move(**result);
+  }
+}
+
+template <typename T> Bool ReadAwaiter<T>::await_ready() const {
+  return mReader.GetAvailable() >= sizeof(T);
+}
+
+template <typename T>
+void ReadAwaiter<T>::await_suspend(std::coroutine_handle<> const &handle) {
+  mReader.Refill(sizeof(T), handle);
+}
+
+template <typename T> T ReadAwaiter<T>::await_resume() {
+  if (mReader.mPending != nullptr) {
+    mReader.FinishRefill();
+  }
+  if (mReader.GetAvailable() < sizeof(T)) {
+    throw Exception::IOException("Unexpected end of file: " +
+                                 mReader.mFile.GetPath());
+  }
+  return mReader.mChunk.template Read<T>();
+}
+} // namespace TerreateIO::Async
+
+#endif // __TERREATEIO_ASYNC_HPP__
@@ -0,0 +1,83 @@
+#ifndef __TERREATEIO_BAKE_HPP__
+#define __TERREATEIO_BAKE_HPP__
+
+#include "buffer.hpp"
+#include "defines.hpp"
+#include "exceptions.hpp"
+
+namespace TerreateIO::Bake {
+using namespace TerreateIO::Defines;
+
+constexpr Uint BAKE_MAGIC = 0x42414954u; // "TIAB"
+constexpr Uint BAKE_VERSION = 1u;
+constexpr Size BAKE_DEFAULT_CAPACITY = 1024ull * 1024ull * 1024ull;
+
+// Layout of a cache entry:
+//   EntryHeader, source path, padding, payload
+// The payload starts on an 8 byte boundary so baked containers can be read in
+// place.
+struct EntryHeader {
+  Uint magic;
+  Uint version;
+  Uint bakerVersion;
+  Uint pathSize;
+  Ulong sourceSize;
+  Long sourceTime;
+  Ulong sourceHash;
+  Ulong payloadOffset;
+  Ulong payloadSize;
+};
+
+// Converts the mapped source into its baked binary form.
+typedef Function<void(Buffer::ReadBuffer &, Buffer::WriteBuffer &)> Baker;
+
+class BakeCache : public TerreateObjectBase {
+private:
+  Str mDirectory;
+  Atomic<Size> mCapacity = BAKE_DEFAULT_CAPACITY;
+  Mutex mMutex;
+  // Entry bytes as of the last directory scan plus this process's own writes
+  // and removals. The directory is only scanned again once this exceeds the
+  // capacity.
+  Size mUsage = 0u;
+  Atomic<Ulong> mHits = 0u;
+  Atomic<Ulong> mMisses = 0u;
+
+private:
+  BakeCache(BakeCache const &) = delete;
+  BakeCache &operator=(BakeCache const &) = delete;
+
+  Str GetEntryPath(Str const &source) const;
+  Bool OpenEntry(Str const &entry, Str const &source, Uint const &bakerVersion,
+                 Buffer::ReadBuffer &buffer, EntryHeader &header) const;
+  void Store(Str const &entry, Str const &source, EntryHeader const &header,
+             Byte const *payload);
+  void UpdateUsage(Size const &added, Size const &removed);
+  void Evict();
+
+public:
+  BakeCache(Str const &directory,
+            Size const &capacity = BAKE_DEFAULT_CAPACITY);
+  ~BakeCache() override = default;
+
+  Str const &GetDirectory() const { return mDirectory; }
+  Size GetCapacity() const { return mCapacity.load(); }
+  Ulong GetHits() const { return mHits.load(); }
+  Ulong GetMisses() const { return mMisses.load(); }
+  Size GetUsage() const;
+
+  void SetCapacity(Size const &capacity);
+
+  // Loads the baked form of `source` into `output`. Entries are reused while
+  // the source size and timestamp are unchanged; if only the timestamp
+  // changed, the content hash decides. On a miss `baker` is run on the mapped
+  // source and its output is stored with an atomic rename. Bumping
+  // `bakerVersion` invalidates everything baked by older bakers.
+  void Load(Str const &source, Buffer::ReadBuffer &output, Baker const &baker,
+            Uint const &bakerVersion = 0u);
+  void Invalidate(Str const &source);
+  void Clear();
+};
+} // namespace TerreateIO::Bake
+
+#endif // __TERREATEIO_BAKE_HPP__
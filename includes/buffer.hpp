@@ -5,40 +5,68 @@
 
 #include "defines.hpp"
 #include "exceptions.hpp"
+#include "instrument.hpp"
 
 namespace TerreateIO::Buffer {
 using namespace TerreateIO::Defines;
 
 class ReadBuffer : public TerreateObjectBase {
 private:
+  Byte *mStorage = nullptr;
+  Size mStorageSize = 0u;
+  Bool mMapped = false;
   Byte *mBuffer = nullptr;
   Byte *mCursor = nullptr;
   Size mSize = 0u;
 
+private:
+  void Release();
+
 public:
   ReadBuffer() = default;
   ReadBuffer(Size const &size)
-      : mBuffer(new Byte[size]), mCursor(mBuffer), mSize(size) {}
-  ReadBuffer(Str const &buffer)
-      : mBuffer(new Byte[buffer.size()]), mCursor(mBuffer),
-        mSize(buffer.size()) {
+      : mStorage(new Byte[size]), mStorageSize(size), mBuffer(mStorage),
+        mCursor(mBuffer), mSize(size) {
+    TIO_COUNT(ALLOCATIONS, 1u);
+  }
+  ReadBuffer(Str const &buffer) : ReadBuffer(buffer.size()) {
     std::memcpy(mBuffer, buffer.data(), buffer.size());
   }
   ReadBuffer(Byte *buffer, Size const &size)
-      : mBuffer(buffer), mCursor(mBuffer), mSize(size) {}
-  ReadBuffer(ReadBuffer const &buffer)
-      : mBuffer(new Byte[buffer.mSize]), mCursor(mBuffer), mSize(buffer.mSize) {
+      : mStorage(buffer), mStorageSize(size), mBuffer(buffer),
+        mCursor(mBuffer), mSize(size) {}
+  ReadBuffer(ReadBuffer const &buffer) : ReadBuffer(buffer.mSize) {
     std::memcpy(mBuffer, buffer.mBuffer, buffer.mSize);
   }
+  ReadBuffer(ReadBuffer &&buffer) noexcept;
   ~ReadBuffer() override;
 
+  Byte const *GetData() const { return mBuffer; }
+  Size const &GetSize() const { return mSize; }
+  Size GetPosition() const { return mCursor - mBuffer; }
+  Bool IsMapped() const { return mMapped; }
+
+  // Maps `size` bytes starting at `offset` of the file. The default maps the
+  // whole file.
+  void MapFile(Str const &path, Size const &offset = 0u,
+               Size const &size = static_cast<Size>(-1));
+  // Restricts the buffer to `size` bytes starting at `offset` without copying
+  // and moves the cursor to the new beginning.
+  void Crop(Size const &offset, Size const &size);
+  // Returns a buffer with its own cursor that borrows this buffer's data. The
+  // view must not outlive this buffer.
+  ReadBuffer View() const;
+
   Str Fetch(Size const &size = 1u);
   Str Read(Size const &size = 1u);
   template <typename T> T Read() {
     T data;
     if (mCursor + sizeof(T) > mBuffer + mSize) {
+      TIO_COUNT(BOUNDS_FAILURES, 1u);
       throw Exception::BufferException("Buffer out of bounds");
     }
+    TIO_COUNT(READ_CALLS, 1u);
+    TIO_COUNT(BYTES_READ, sizeof(T));
     std::memcpy(&data, mCursor, sizeof(T));
     mCursor += sizeof(T);
     return data;
@@ -47,6 +75,7 @@ public:
   void SkipWhitespace();
 
   ReadBuffer &operator=(ReadBuffer const &buffer);
+  ReadBuffer &operator=(ReadBuffer &&buffer) noexcept;
 };
 
 class WriteBuffer : public TerreateObjectBase {
@@ -58,15 +87,28 @@ public:
   WriteBuffer(WriteBuffer const &buffer) : mStream(buffer.mStream.str()) {}
   ~WriteBuffer() override = default;
 
-  void Write(Str const &data) { mStream << data; }
+  void Write(Str const &data) {
+    TIO_COUNT(BYTES_WRITTEN, data.size());
+    mStream << data;
+  }
   void Write(Byte const *data, Size const &size) {
+    TIO_COUNT(BYTES_WRITTEN, size);
     mStream.write((const char *)data, size);
   }
   template <typename T> void Write(T const &data) {
     this->Write((Byte const *)&data, sizeof(T));
   }
 
+  Size GetSize() { return static_cast<Size>(mStream.tellp()); }
+
+  void Align(Size const &alignment);
+  void Patch(Size const &offset, Byte const *data, Size const &size);
+  template <typename T> void Patch(Size const &offset, T const &data) {
+    this->Patch(offset, (Byte const *)&data, sizeof(T));
+  }
+
   Str Dump() { return mStream.str(); }
+  void Clear() { mStream.str(Str()); }
 
   WriteBuffer &operator=(WriteBuffer const &buffer);
 };
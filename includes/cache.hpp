@@ -0,0 +1,88 @@
+#ifndef __TERREATEIO_CACHE_HPP__
+#define __TERREATEIO_CACHE_HPP__
+
+#include <list>
+#include <memory>
+
+#include "buffer.hpp"
+#include "defines.hpp"
+#include "exceptions.hpp"
+
+namespace TerreateIO::Cache {
+using namespace TerreateIO::Defines;
+
+constexpr Size CACHE_NUM_SHARDS = 16u;
+constexpr Size CACHE_DEFAULT_BUDGET = 512ull * 1024ull * 1024ull;
+
+// Shared, read-only handle to a decoded buffer. Use ReadBuffer::View() to get
+// a private cursor over the shared data.
+typedef std::shared_ptr<Buffer::ReadBuffer const> SharedBuffer;
+// Decodes the asset into the given buffer.
+typedef Function<void(Buffer::ReadBuffer &)> Loader;
+
+class AssetCache : public TerreateObjectBase {
+private:
+  struct Entry {
+    Ulong generation = 0u;
+    SharedFuture<SharedBuffer> future;
+    Size size = 0u;
+    Bool ready = false;
+    Bool referenced = true;
+    std::list<Str>::iterator position;
+  };
+
+  // Each shard runs its own CLOCK over its entries, so lookups only take the
+  // lock of the shard the key hashes to. The budget applies to the whole
+  // cache and eviction sweeps the shards in turn.
+  struct Shard {
+    Mutex mutex;
+    Map<Str, Entry> entries;
+    std::list<Str> clock;
+    std::list<Str>::iterator hand = clock.end();
+    Ulong generation = 0u;
+  };
+
+private:
+  Shard mShards[CACHE_NUM_SHARDS];
+  Atomic<Size> mBudget = CACHE_DEFAULT_BUDGET;
+  Atomic<Size> mUsage = 0u;
+  Atomic<Size> mEvictionShard = 0u;
+  Atomic<Ulong> mHits = 0u;
+  Atomic<Ulong> mMisses = 0u;
+
+private:
+  AssetCache(AssetCache const &) = delete;
+  AssetCache &operator=(AssetCache const &) = delete;
+
+  Shard &GetShard(Str const &key);
+  void Erase(Shard &shard, Map<Str, Entry>::iterator const &entry);
+  void Sweep(Shard &shard, Size const &budget);
+  void Evict();
+
+public:
+  AssetCache(Size const &budget = CACHE_DEFAULT_BUDGET) : mBudget(budget) {}
+  ~AssetCache() override = default;
+
+  Size GetBudget() const { return mBudget.load(); }
+  Size GetUsage() const { return mUsage.load(); }
+  Ulong GetHits() const { return mHits.load(); }
+  Ulong GetMisses() const { return mMisses.load(); }
+
+  void SetBudget(Size const &budget);
+
+  // Returns the cached buffer for `key`, running `loader` on a miss.
+  // Concurrent requests for a key that is being loaded wait for that load
+  // instead of starting their own. Exceptions thrown by `loader` are passed
+  // to every waiting caller and nothing is cached.
+  SharedBuffer Acquire(Str const &key, Loader const &loader);
+  SharedBuffer Acquire(Ulong const &contentHash, Loader const &loader);
+  SharedBuffer Find(Str const &key);
+  void Invalidate(Str const &key);
+  void Clear();
+
+public:
+  static AssetCache &GetGlobal();
+};
+} // namespace TerreateIO::Cache
+
+#endif // __TERREATEIO_CACHE_HPP__
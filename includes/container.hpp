@@ -0,0 +1,274 @@
+#ifndef __TERREATEIO_CONTAINER_HPP__
+#define __TERREATEIO_CONTAINER_HPP__
+
+#include <bit>
+#include <cstring>
+#include <string_view>
+
+#include "buffer.hpp"
+#include "defines.hpp"
+#include "exceptions.hpp"
+
+namespace TerreateIO::Container {
+using namespace TerreateIO::Defines;
+
+// Containers are stored little-endian and read in place.
+static_assert(std::endian::native == std::endian::little,
+              "TerreateIO containers require a little-endian host");
+
+typedef Uint Offset;
+
+constexpr Uint CONTAINER_MAGIC = 0x434F4954u; // "TIOC"
+constexpr Uint CONTAINER_VERSION = 1u;
+constexpr Size CONTAINER_ALIGNMENT = 8u;
+constexpr Ushort CONTAINER_MAX_FIELDS = 0xFFFFu;
+
+enum class FieldKind : Ubyte {
+  NONE = 0,
+  SCALAR,
+  TABLE,
+  VECTOR,
+  TABLE_VECTOR,
+  STRING
+};
+
+struct Header {
+  Uint magic;
+  Uint version;
+  Offset root;
+  Uint size;
+};
+
+// Layout of a table:
+//   vtable  : Ushort numFields, Ushort tableSize, FieldEntry[numFields]
+//   table   : Offset vtable, field data...
+// Field offsets are relative to the table. References to tables, vectors and
+// strings are offsets from the beginning of the container and always point
+// backwards, so a container can be verified without cycle detection.
+struct FieldEntry {
+  Ushort offset;
+  Ushort size;
+  Ubyte kind;
+  Ubyte alignment;
+};
+
+struct TableRef {
+  Offset offset = 0u;
+};
+
+struct StringRef {
+  Offset offset = 0u;
+};
+
+struct TableVectorRef {
+  Offset offset = 0u;
+};
+
+template <typename T> struct VectorRef {
+  Offset offset = 0u;
+};
+
+template <typename T> inline T Load(Byte const *buffer, Offset const &offset) {
+  T data;
+  std::memcpy(&data, buffer + offset, sizeof(T));
+  return data;
+}
+
+template <typename T> class VectorView {
+private:
+  Byte const *mData = nullptr;
+  Uint mCount = 0u;
+
+public:
+  VectorView() = default;
+  VectorView(Byte const *data, Uint const &count)
+      : mData(data), mCount(count) {}
+
+  Uint const &GetCount() const { return mCount; }
+  T const *GetData() const { return reinterpret_cast<T const *>(mData); }
+
+  Bool IsEmpty() const { return mCount == 0u; }
+
+  T const *begin() const { return this->GetData(); }
+  T const *end() const { return this->GetData() + mCount; }
+
+  T operator[](Uint const &index) const {
+    return Load<T>(mData, index * sizeof(T));
+  }
+};
+
+class TableVector;
+
+class Table {
+private:
+  Byte const *mBuffer = nullptr;
+  Offset mOffset = 0u;
+
+private:
+  FieldEntry GetFieldEntry(Ushort const &id) const;
+  // Returns 0 unless the field exists with the expected kind and size and is
+  // aligned for it, so a verified container is never read past a field with a
+  // different type.
+  Offset GetFieldOffset(Ushort const &id, FieldKind const &kind,
+                        Size const &size, Size const &alignment) const;
+  Offset GetReference(Ushort const &id, FieldKind const &kind,
+                      Size const &size, Size const &alignment) const;
+
+public:
+  Table() = default;
+  Table(Byte const *buffer, Offset const &offset)
+      : mBuffer(buffer), mOffset(offset) {}
+
+  Offset const &GetOffset() const { return mOffset; }
+
+  Bool IsValid() const { return mBuffer != nullptr; }
+  Bool HasField(Ushort const &id) const {
+    return this->GetFieldEntry(id).offset != 0u;
+  }
+
+  template <typename T>
+  T GetScalar(Ushort const &id, T const &defaultValue = T()) const {
+    Offset offset =
+        this->GetFieldOffset(id, FieldKind::SCALAR, sizeof(T), alignof(T));
+    return offset == 0u ? defaultValue : Load<T>(mBuffer, offset);
+  }
+  Table GetTable(Ushort const &id) const;
+  template <typename T> VectorView<T> GetVector(Ushort const &id) const {
+    Offset offset =
+        this->GetReference(id, FieldKind::VECTOR, sizeof(T), alignof(T));
+    if (offset == 0u) {
+      return VectorView<T>();
+    }
+    return VectorView<T>(mBuffer + offset + sizeof(Uint),
+                         Load<Uint>(mBuffer, offset));
+  }
+  std::string_view GetString(Ushort const &id) const;
+  TableVector GetTableVector(Ushort const &id) const;
+};
+
+class TableVector {
+private:
+  Byte const *mBuffer = nullptr;
+  Offset mOffset = 0u;
+  Uint mCount = 0u;
+
+public:
+  TableVector() = default;
+  TableVector(Byte const *buffer, Offset const &offset, Uint const &count)
+      : mBuffer(buffer), mOffset(offset), mCount(count) {}
+
+  Uint const &GetCount() const { return mCount; }
+
+  Bool IsEmpty() const { return mCount == 0u; }
+
+  Table operator[](Uint const &index) const {
+    return Table(mBuffer,
+                 Load<Offset>(mBuffer, mOffset + index * sizeof(Offset)));
+  }
+};
+
+class ContainerWriter : public TerreateObjectBase {
+private:
+  struct PendingField {
+    Ushort id;
+    FieldKind kind;
+    Ushort size;
+    Ubyte alignment;
+    Size dataIndex;
+  };
+
+private:
+  Buffer::WriteBuffer &mBuffer;
+  Size mBase = 0u;
+  Bool mInTable = false;
+  Bool mFinished = false;
+  Vec<PendingField> mFields;
+  Str mFieldData;
+  Map<Str, Offset> mVTables;
+
+private:
+  ContainerWriter(ContainerWriter const &) = delete;
+  ContainerWriter &operator=(ContainerWriter const &) = delete;
+
+  // Throws once the container no longer fits into Offset.
+  void CheckSize() const;
+  Offset GetPosition() const;
+  void CheckWritable() const;
+  void AddField(Ushort const &id, FieldKind const &kind, Ushort const &size,
+                Ubyte const &alignment, Byte const *data);
+  Offset BeginVector(Uint const &count, Size const &alignment);
+  Offset WriteVTable(Str const &vtable);
+
+public:
+  ContainerWriter(Buffer::WriteBuffer &buffer);
+  ~ContainerWriter() override = default;
+
+  StringRef CreateString(Str const &string);
+  template <typename T>
+  VectorRef<T> CreateVector(T const *data, Uint const &count) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "Vector elements must be trivially copyable");
+    static_assert(alignof(T) <= CONTAINER_ALIGNMENT,
+                  "Vector elements are over-aligned");
+    Offset offset = this->BeginVector(count, alignof(T));
+    mBuffer.Write((Byte const *)data, sizeof(T) * count);
+    this->CheckSize();
+    return VectorRef<T>{offset};
+  }
+  template <typename T> VectorRef<T> CreateVector(Vec<T> const &data) {
+    return this->CreateVector(data.data(), static_cast<Uint>(data.size()));
+  }
+  TableVectorRef CreateTableVector(Vec<TableRef> const &tables);
+
+  void StartTable();
+  template <typename T> void AddScalar(Ushort const &id, T const &data) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "Scalars must be trivially copyable");
+    static_assert(alignof(T) <= CONTAINER_ALIGNMENT,
+                  "Scalars are over-aligned");
+    this->AddField(id, FieldKind::SCALAR, sizeof(T), alignof(T),
+                   (Byte const *)&data);
+  }
+  void AddTable(Ushort const &id, TableRef const &table);
+  void AddString(Ushort const &id, StringRef const &string);
+  template <typename T>
+  void AddVector(Ushort const &id, VectorRef<T> const &vector) {
+    this->AddField(id, FieldKind::VECTOR, sizeof(T), alignof(T),
+                   (Byte const *)&vector.offset);
+  }
+  void AddTableVector(Ushort const &id, TableVectorRef const &vector);
+  TableRef EndTable();
+
+  void Finish(TableRef const &root);
+};
+
+class ContainerReader : public TerreateObjectBase {
+private:
+  Byte const *mBuffer = nullptr;
+  Size mSize = 0u;
+  Offset mRoot = 0u;
+
+private:
+  void VerifyTable(Offset const &offset, Uint const &depth,
+                   Uint const &maxDepth, Uint &numTables,
+                   Uint const &maxTables) const;
+  Uint VerifyVector(Offset const &offset, Offset const &owner,
+                    Size const &elementSize, Size const &alignment) const;
+
+public:
+  ContainerReader(Buffer::ReadBuffer const &buffer);
+  ContainerReader(Byte const *buffer, Size const &size);
+  ~ContainerReader() override = default;
+
+  Size const &GetSize() const { return mSize; }
+  Table GetRoot() const { return Table(mBuffer, mRoot); }
+
+  // Walks every table, vector and string reachable from the root and checks
+  // that all offsets stay inside the container. Call this once before
+  // accessing containers that come from untrusted sources.
+  void Verify(Uint const &maxDepth = 64u,
+              Uint const &maxTables = 1000000u) const;
+};
+} // namespace TerreateIO::Container
+
+#endif // __TERREATEIO_CONTAINER_HPP__
@@ -25,6 +25,31 @@ public:
   BufferException(const std::string &message) : TerreateIOException(message) {}
 };
 
+class ContainerException : public TerreateIOException {
+public:
+  ContainerException(const char *message) : TerreateIOException(message) {}
+  ContainerException(const std::string &message)
+      : TerreateIOException(message) {}
+};
+
+class CacheException : public TerreateIOException {
+public:
+  CacheException(const char *message) : TerreateIOException(message) {}
+  CacheException(const std::string &message) : TerreateIOException(message) {}
+};
+
+class IOException : public TerreateIOException {
+public:
+  IOException(const char *message) : TerreateIOException(message) {}
+  IOException(const std::string &message) : TerreateIOException(message) {}
+};
+
+class MeshException : public TerreateIOException {
+public:
+  MeshException(const char *message) : TerreateIOException(message) {}
+  MeshException(const std::string &message) : TerreateIOException(message) {}
+};
+
 } // namespace TerreateIO::Exception
 
 #endif // __TERRATEIO_EXCEPTIONS_HPP__
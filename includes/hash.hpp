@@ -0,0 +1,48 @@
+#ifndef __TERREATEIO_HASH_HPP__
+#define __TERREATEIO_HASH_HPP__
+
+#include <cstring>
+
+#include "defines.hpp"
+
+namespace TerreateIO::Hash {
+using namespace TerreateIO::Defines;
+
+constexpr Ulong HASH_SEED = 0xCBF29CE484222325ull;
+constexpr Ulong HASH_MULTIPLIER = 0x9E3779B97F4A7C15ull;
+
+inline Ulong Mix(Ulong hash) {
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDull;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53ull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+// Non-cryptographic 64 bit hash used for cache keys and content checks. It
+// consumes eight bytes per step, so hashing is cheap compared to parsing.
+inline Ulong HashBytes(Byte const *data, Size const &size,
+                       Ulong const &seed = HASH_SEED) {
+  Ulong hash = seed ^ (size * HASH_MULTIPLIER);
+  Size index = 0u;
+  for (; index + sizeof(Ulong) <= size; index += sizeof(Ulong)) {
+    Ulong word;
+    std::memcpy(&word, data + index, sizeof(Ulong));
+    hash = (hash ^ word) * HASH_MULTIPLIER;
+    hash ^= hash >> 29;
+  }
+  if (index < size) {
+    Ulong word = 0u;
+    std::memcpy(&word, data + index, size - index);
+    hash = (hash ^ word) * HASH_MULTIPLIER;
+  }
+  return Mix(hash);
+}
+
+inline Ulong HashString(Str const &string, Ulong const &seed = HASH_SEED) {
+  return HashBytes((Byte const *)string.data(), string.size(), seed);
+}
+} // namespace TerreateIO::Hash
+
+#endif // __TERREATEIO_HASH_HPP__
@@ -0,0 +1,110 @@
+#ifndef __TERREATEIO_INSTRUMENT_HPP__
+#define __TERREATEIO_INSTRUMENT_HPP__
+
+#include "defines.hpp"
+
+namespace TerreateIO::Instrument {
+using namespace TerreateIO::Defines;
+
+enum class Counter : Uint {
+  BYTES_READ = 0,
+  BYTES_WRITTEN,
+  FETCH_CALLS,
+  READ_CALLS,
+  ALLOCATIONS,
+  BOUNDS_FAILURES,
+  NUM_COUNTERS
+};
+
+enum class Latency : Uint { LOAD = 0, DECODE, ENCODE, NUM_LATENCIES };
+
+constexpr Uint NUM_COUNTERS = static_cast<Uint>(Counter::NUM_COUNTERS);
+constexpr Uint NUM_LATENCIES = static_cast<Uint>(Latency::NUM_LATENCIES);
+constexpr Uint NUM_HISTOGRAM_BUCKETS = 64u;
+
+// Bucket i holds the samples whose duration in nanoseconds has a bit width
+// of i, i.e. lies in [2^(i-1), 2^i).
+struct Histogram {
+  Ulong buckets[NUM_HISTOGRAM_BUCKETS] = {0u};
+  Ulong count = 0u;
+  Ulong total = 0u;
+  Ulong max = 0u;
+
+  Double GetMean() const {
+    return count == 0u ? 0.0 : static_cast<Double>(total) / count;
+  }
+  // Upper bound in nanoseconds of the bucket holding the given percentile.
+  Ulong GetPercentile(Double const &percentile) const;
+};
+
+struct Snapshot {
+  Ulong counters[NUM_COUNTERS] = {0u};
+  Histogram histograms[NUM_LATENCIES];
+
+  Ulong Get(Counter const &counter) const {
+    return counters[static_cast<Uint>(counter)];
+  }
+  Histogram const &Get(Latency const &latency) const {
+    return histograms[static_cast<Uint>(latency)];
+  }
+};
+
+struct TraceStamp {
+  Str name;
+  Latency latency;
+  Uint thread;
+  SteadyTimePoint start;
+  SteadyTimePoint end;
+};
+
+void Increment(Counter const &counter, Ulong const &amount = 1u);
+void Record(Str const &name, Latency const &latency,
+            SteadyTimePoint const &start, SteadyTimePoint const &end);
+
+// Trace stamps are only kept while tracing is enabled, since they grow with
+// every recorded scope. Counters and histograms are always collected.
+void SetTracing(Bool const &enabled);
+Bool IsTracing();
+
+// Sums the per-thread counters. Only called on demand, so the hot paths never
+// touch shared cache lines.
+Snapshot GetSnapshot();
+void Reset();
+
+// Emits the recorded stamps in the Chrome trace event format, which can be
+// opened with chrome://tracing or Perfetto.
+Str CreateTraceTimeLine();
+
+class ScopedTimer {
+private:
+  Str mName;
+  Latency mLatency;
+  SteadyTimePoint mStart;
+
+private:
+  ScopedTimer(ScopedTimer const &) = delete;
+  ScopedTimer &operator=(ScopedTimer const &) = delete;
+
+public:
+  ScopedTimer(Str const &name, Latency const &latency)
+      : mName(name), mLatency(latency), mStart(Now()) {}
+  ~ScopedTimer() { Record(mName, mLatency, mStart, Now()); }
+};
+} // namespace TerreateIO::Instrument
+
+#define TERREATEIO_CONCAT_IMPL(a, b) a##b
+#define TERREATEIO_CONCAT(a, b) TERREATEIO_CONCAT_IMPL(a, b)
+
+#ifdef TERREATEIO_INSTRUMENTATION
+#define TIO_COUNT(counter, amount)                                             \
+  ::TerreateIO::Instrument::Increment(                                         \
+      ::TerreateIO::Instrument::Counter::counter, amount)
+#define TIO_SCOPE(name, latency)                                               \
+  ::TerreateIO::Instrument::ScopedTimer TERREATEIO_CONCAT(tioScope, __LINE__)( \
+      name, ::TerreateIO::Instrument::Latency::latency)
+#else
+#define TIO_COUNT(counter, amount) ((void)0)
+#define TIO_SCOPE(name, latency) ((void)0)
+#endif // TERREATEIO_INSTRUMENTATION
+
+#endif // __TERREATEIO_INSTRUMENT_HPP__
@@ -0,0 +1,105 @@
+#ifndef __TERREATEIO_MESH_HPP__
+#define __TERREATEIO_MESH_HPP__
+
+#include <bit>
+
+#include "buffer.hpp"
+#include "defines.hpp"
+#include "exceptions.hpp"
+
+namespace TerreateIO::Mesh {
+using namespace TerreateIO::Defines;
+
+// Meshes are stored little-endian and decoded with plain copies.
+static_assert(std::endian::native == std::endian::little,
+              "TerreateIO meshes require a little-endian host");
+
+constexpr Uint MESH_MAGIC = 0x4D4F4954u; // "TIOM"
+constexpr Uint MESH_VERSION = 1u;
+constexpr Uint MESH_DEFAULT_CACHE_SIZE = 32u;
+constexpr Uint MESH_FLAG_QUANTIZED = 1u << 0;
+constexpr Uint MESH_FLAG_SHORT_INDICES = 1u << 1;
+
+struct Vertex {
+  Float position[3];
+  Float normal[3];
+  Float uv[2];
+};
+
+struct MeshData {
+  Vec<Vertex> vertices;
+  Vec<Uint> indices;
+};
+
+// Positions are unorm16 relative to the mesh bounds, normals are octahedral
+// snorm16 and uvs are half floats. position[3] pads the vertex to 16 bytes.
+struct QuantizedVertex {
+  Ushort position[4];
+  Short normal[2];
+  Ushort uv[2];
+};
+
+static_assert(sizeof(QuantizedVertex) == 16u);
+
+// Layout of a mesh:
+//   MeshHeader, vertices[vertexCount], indices[indexCount]
+// Vertices are QuantizedVertex when MESH_FLAG_QUANTIZED is set and Vertex
+// otherwise, indices are Ushort when MESH_FLAG_SHORT_INDICES is set and Uint
+// otherwise.
+struct MeshHeader {
+  Uint magic;
+  Uint version;
+  Uint flags;
+  Uint vertexStride;
+  Uint vertexCount;
+  Uint indexCount;
+  Float boundsMin[3];
+  Float boundsMax[3];
+};
+
+struct ExportOptions {
+  Bool optimizeVertexCache = true;
+  Bool optimizeVertexFetch = true;
+  Bool quantize = true;
+  Bool narrowIndices = true;
+  Uint cacheSize = MESH_DEFAULT_CACHE_SIZE;
+};
+
+struct ExportMetrics {
+  // Size of the float vertices and 32-bit indices the mesh started with.
+  Size rawSize = 0u;
+  Size exportedSize = 0u;
+  // Average number of vertex cache misses per triangle.
+  Double acmrBefore = 0.0;
+  Double acmrAfter = 0.0;
+  Double optimizeMilliSec = 0.0;
+  Double encodeMilliSec = 0.0;
+
+  Double GetCompressionRatio() const {
+    return exportedSize == 0u ? 0.0
+                              : static_cast<Double>(rawSize) / exportedSize;
+  }
+};
+
+Ushort EncodeHalf(Float const &value);
+Float DecodeHalf(Ushort const &value);
+void EncodeOctahedral(Float const *normal, Short *encoded);
+void DecodeOctahedral(Short const *encoded, Float *normal);
+
+// Simulates a FIFO post-transform cache of `cacheSize` entries.
+Double GetACMR(Vec<Uint> const &indices, Size const &vertexCount,
+               Uint const &cacheSize = MESH_DEFAULT_CACHE_SIZE);
+// Reorders the triangles with Forsyth's linear-speed vertex cache
+// optimization.
+void OptimizeVertexCache(Vec<Uint> &indices, Size const &vertexCount,
+                         Uint const &cacheSize = MESH_DEFAULT_CACHE_SIZE);
+// Reorders the vertices in order of first use and drops unreferenced ones.
+// Meshes without indices are left untouched.
+void OptimizeVertexFetch(MeshData &mesh);
+
+ExportMetrics ExportMesh(MeshData const &mesh, Buffer::WriteBuffer &buffer,
+                         ExportOptions const &options = ExportOptions());
+MeshData ImportMesh(Buffer::ReadBuffer &buffer);
+} // namespace TerreateIO::Mesh
+
+#endif // __TERREATEIO_MESH_HPP__
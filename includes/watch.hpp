@@ -0,0 +1,115 @@
+#ifndef __TERREATEIO_WATCH_HPP__
+#define __TERREATEIO_WATCH_HPP__
+
+#include "buffer.hpp"
+#include "cache.hpp"
+#include "defines.hpp"
+#include "exceptions.hpp"
+
+namespace TerreateIO::Watch {
+using namespace TerreateIO::Defines;
+
+constexpr MilliSec WATCH_DEFAULT_DEBOUNCE = MilliSec(20);
+// Continuous writes are flushed after this long even if they never settle.
+constexpr MilliSec WATCH_MAX_DELAY = MilliSec(80);
+
+// Receives the paths that changed since the last call.
+typedef Function<void(Vec<Str> const &)> ChangeCallback;
+// Receives the key of a re-imported asset and whether the import succeeded.
+typedef Function<void(Str const &, Bool const &)> ReloadListener;
+
+// Watches files through inotify on their parent directories, so editors that
+// save by renaming a temporary file are picked up as well. Events are
+// coalesced per path and delivered in one batch once they settle for the
+// debounce interval.
+class FileWatcher : public TerreateObjectBase {
+private:
+  int mDescriptor = -1;
+  int mWakeup = -1;
+  Mutex mMutex;
+  Map<int, Str> mDirectories;
+  Map<Str, int> mWatches;
+  Map<Str, Uint> mWatchCounts;
+  Set<Str> mFiles;
+  MilliSec mDebounce;
+  ChangeCallback mCallback;
+  Atomic<Bool> mRunning = true;
+  Thread mThread;
+
+private:
+  FileWatcher(FileWatcher const &) = delete;
+  FileWatcher &operator=(FileWatcher const &) = delete;
+
+  Bool ReadEvents(Set<Str> &pending);
+  void Worker();
+
+public:
+  FileWatcher(ChangeCallback const &callback,
+              MilliSec const &debounce = WATCH_DEFAULT_DEBOUNCE);
+  ~FileWatcher() override;
+
+  void Watch(Str const &path);
+  void Unwatch(Str const &path);
+};
+
+// Keeps imported assets up to date with their sources. Only assets depending
+// on a changed source are re-imported, and the new buffer replaces the old one
+// atomically, so readers always see either the old or the new version.
+class HotReloader : public TerreateObjectBase {
+private:
+  struct Asset {
+    Str key;
+    Vec<Str> sources;
+    Cache::Loader loader;
+    // Serializes the imports of one asset, so an older import never replaces
+    // the result of a newer one.
+    Mutex mutex;
+    // Only guards swapping the pointer, so readers never wait for an import.
+    mutable Mutex bufferMutex;
+    Cache::SharedBuffer buffer;
+    Atomic<Ulong> version = 0u;
+
+    Cache::SharedBuffer Load() const {
+      LockGuard<Mutex> lock(bufferMutex);
+      return buffer;
+    }
+    void Store(Cache::SharedBuffer const &decoded) {
+      LockGuard<Mutex> lock(bufferMutex);
+      buffer = decoded;
+    }
+  };
+
+private:
+  mutable Mutex mMutex;
+  Map<Str, std::shared_ptr<Asset>> mAssets;
+  Map<Str, Set<Str>> mDependents;
+  ReloadListener mListener;
+  FileWatcher mWatcher;
+
+private:
+  HotReloader(HotReloader const &) = delete;
+  HotReloader &operator=(HotReloader const &) = delete;
+
+  std::shared_ptr<Asset> FindAsset(Str const &key) const;
+  void Release(Asset const &asset);
+  void OnChange(Vec<Str> const &paths);
+
+public:
+  HotReloader(MilliSec const &debounce = WATCH_DEFAULT_DEBOUNCE);
+  ~HotReloader() override = default;
+
+  // Imports the asset once and re-imports it whenever one of `sources`
+  // changes. Exceptions of the initial import are passed to the caller; later
+  // failures keep the previous buffer and are reported to the listener.
+  Cache::SharedBuffer Track(Str const &key, Vec<Str> const &sources,
+                            Cache::Loader const &loader);
+  void Untrack(Str const &key);
+
+  Cache::SharedBuffer Get(Str const &key) const;
+  Ulong GetVersion(Str const &key) const;
+
+  void SetListener(ReloadListener const &listener);
+};
+} // namespace TerreateIO::Watch
+
+#endif // __TERREATEIO_WATCH_HPP__
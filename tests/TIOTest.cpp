@@ -1,12 +1,317 @@
+#ifndef _WIN32
+#include "../includes/async.hpp"
+#endif
+#include "../includes/bake.hpp"
 #include "../includes/buffer.hpp"
+#include "../includes/cache.hpp"
+#include "../includes/container.hpp"
+#include "../includes/instrument.hpp"
+#include "../includes/mesh.hpp"
+#ifdef __linux__
+#include "../includes/watch.hpp"
+#endif
 
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
 #include <iostream>
 
 using namespace TerreateIO;
+using namespace TerreateIO::Defines;
+
+#ifndef _WIN32
+Async::AsyncTask<void> WriteValues(Async::EventLoop &loop, Str const &path) {
+  Async::AsyncFile file(loop, path, Async::OpenMode::WRITE);
+  Async::AsyncWriter writer(file);
+  for (Uint i = 0u; i < 100u; ++i) {
+    writer.Write(i);
+  }
+  co_await writer.FlushAsync();
+}
+
+Async::AsyncTask<Uint> SumValues(Async::EventLoop &loop, Str const &path) {
+  Async::AsyncFile file(loop, path);
+  Async::AsyncReader reader(file, 64u);
+  Uint sum = 0u;
+  for (Uint i = 0u; i < 100u; ++i) {
+    sum += co_await reader.ReadAsync<Uint>();
+  }
+  co_return sum;
+}
+
+Async::AsyncTask<Uint> StopAndSum(Async::EventLoop &loop, Str const &path) {
+  loop.Stop();
+  co_return co_await SumValues(loop, path);
+}
+#endif
 
 int main() {
   Buffer::WriteBuffer wb;
   wb.Write((unsigned)1000);
   Buffer::ReadBuffer rb(wb.Dump());
   std::cout << rb.Read<int>() << std::endl;
+
+  Buffer::WriteBuffer cwb;
+  Container::ContainerWriter writer(cwb);
+  auto name = writer.CreateString("mesh");
+  auto positions = writer.CreateVector(Vec<Double>{0.0, 1.0, 2.0});
+  writer.StartTable();
+  writer.AddScalar<Uint>(0, 42u);
+  writer.AddString(1, name);
+  writer.AddVector(2, positions);
+  writer.Finish(writer.EndTable());
+
+  Buffer::ReadBuffer crb(cwb.Dump());
+  Container::ContainerReader reader(crb);
+  reader.Verify();
+  auto root = reader.GetRoot();
+  std::cout << root.GetScalar<Uint>(0) << " " << root.GetString(1) << " "
+            << root.GetVector<Double>(2)[2] << std::endl;
+
+  // Accessors must not trust a field whose kind or size does not match.
+  Buffer::WriteBuffer mismatchWb;
+  Container::ContainerWriter mismatchWriter(mismatchWb);
+  auto bytes = mismatchWriter.CreateVector(Vec<Ubyte>{1u, 2u, 3u});
+  mismatchWriter.StartTable();
+  mismatchWriter.AddScalar<Uint>(0, 0x7FFFFFF0u);
+  mismatchWriter.AddScalar<Ubyte>(1, 7u);
+  mismatchWriter.AddVector(2, bytes);
+  mismatchWriter.Finish(mismatchWriter.EndTable());
+  Buffer::ReadBuffer mismatchRb(mismatchWb.Dump());
+  Container::ContainerReader mismatchReader(mismatchRb);
+  mismatchReader.Verify();
+  auto mismatch = mismatchReader.GetRoot();
+  std::cout << mismatch.GetString(0).size() << " "
+            << mismatch.GetTable(0).IsValid() << " "
+            << mismatch.GetVector<Uint>(0).GetCount() << " "
+            << mismatch.GetScalar<Ulong>(1) << " "
+            << mismatch.GetVector<Double>(2).GetCount() << " "
+            << mismatch.GetVector<Ubyte>(2).GetCount() << std::endl;
+  // An 8 byte vector is only read as Double if it was written 8-aligned.
+  struct Packed {
+    Ubyte bytes[8];
+  };
+  Buffer::WriteBuffer packedWb;
+  Container::ContainerWriter packedWriter(packedWb);
+  auto packed = packedWriter.CreateVector(Vec<Packed>(3u));
+  packedWriter.StartTable();
+  packedWriter.AddVector(0, packed);
+  packedWriter.Finish(packedWriter.EndTable());
+  Buffer::ReadBuffer packedRb(packedWb.Dump());
+  Container::ContainerReader packedReader(packedRb);
+  packedReader.Verify();
+  std::cout << packedReader.GetRoot().GetVector<Double>(0).GetCount() << " "
+            << packedReader.GetRoot().GetVector<Packed>(0).GetCount()
+            << std::endl;
+  auto missing = mismatch.GetTable(3);
+  std::cout << missing.HasField(0) << " " << missing.GetScalar<Uint>(0, 7u)
+            << " " << missing.GetString(0).size() << " "
+            << missing.GetTable(0).IsValid() << " "
+            << missing.GetTableVector(0).GetCount() << std::endl;
+
+  Buffer::WriteBuffer rangeWb;
+  Container::ContainerWriter rangeWriter(rangeWb);
+  rangeWriter.StartTable();
+  try {
+    rangeWriter.AddScalar<Uint>(0xFFFFu, 1u);
+  } catch (Exception::ContainerException const &exception) {
+    std::cout << exception.what() << std::endl;
+  }
+
+  // A hit reuses the baked entry, a changed source is baked again.
+  Str bakeDirectory =
+      (std::filesystem::temp_directory_path() / "TIOTestBake").string();
+  Str bakeSource = bakeDirectory + "_source.txt";
+  std::filesystem::remove_all(bakeDirectory);
+  OutputFileStream(bakeSource) << "source";
+  Bake::BakeCache bakeCache(bakeDirectory);
+  Uint bakes = 0u;
+  Bake::Baker baker = [&bakes](Buffer::ReadBuffer &source,
+                               Buffer::WriteBuffer &baked) {
+    ++bakes;
+    baked.Write(source.Read(source.GetSize()) + " baked");
+  };
+  Buffer::ReadBuffer bakedRb;
+  bakeCache.Load(bakeSource, bakedRb, baker);
+  bakeCache.Load(bakeSource, bakedRb, baker);
+  std::cout << bakes << " " << bakedRb.Read(bakedRb.GetSize()) << std::endl;
+  OutputFileStream(bakeSource) << "changed source";
+  bakeCache.Load(bakeSource, bakedRb, baker);
+  std::cout << bakes << " " << bakedRb.Read(bakedRb.GetSize()) << std::endl;
+  // The capacity may change while other threads bake.
+  Thread resizer([&bakeCache]() {
+    for (Size i = 0u; i < 16u; ++i) {
+      bakeCache.SetCapacity(i % 2u == 0u ? 1u : Bake::BAKE_DEFAULT_CAPACITY);
+    }
+  });
+  for (Uint i = 0u; i < 16u; ++i) {
+    bakeCache.Load(bakeSource, bakedRb, baker);
+  }
+  resizer.join();
+  bakeCache.SetCapacity(Bake::BAKE_DEFAULT_CAPACITY);
+  std::cout << (bakeCache.GetCapacity() == Bake::BAKE_DEFAULT_CAPACITY)
+            << std::endl;
+  std::filesystem::remove_all(bakeDirectory);
+  std::filesystem::remove(bakeSource);
+
+  // Concurrent misses on one key share a single load, and an asset larger
+  // than a shard's share of the budget stays cached.
+  Cache::AssetCache cache(16u << 20);
+  Atomic<Uint> loads = 0u;
+  Cache::Loader loadLarge = [&loads](Buffer::ReadBuffer &buffer) {
+    ++loads;
+    std::this_thread::sleep_for(MilliSec(10));
+    buffer = Buffer::ReadBuffer(Size(2u << 20));
+  };
+  Vec<Thread> threads;
+  for (Uint i = 0u; i < 8u; ++i) {
+    threads.emplace_back([&cache, &loadLarge]() {
+      cache.Acquire("large", loadLarge);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  cache.Acquire("large", loadLarge);
+  std::cout << loads << " " << cache.GetUsage() << std::endl;
+  for (Uint i = 0u; i < 16u; ++i) {
+    cache.Acquire("asset" + ToStr(i), loadLarge);
+  }
+  std::cout << (cache.GetUsage() <= cache.GetBudget()) << " ";
+  cache.Clear();
+  std::cout << cache.GetUsage() << std::endl;
+
+#ifndef _WIN32
+  Async::EventLoop loop;
+  Str asyncPath =
+      (std::filesystem::temp_directory_path() / "TIOTestAsync.bin").string();
+  loop.RunUntilComplete(WriteValues(loop, asyncPath));
+  Uint sum = loop.RunUntilComplete(SumValues(loop, asyncPath));
+  Async::AsyncFile asyncFile(loop, asyncPath);
+  Buffer::ReadBuffer loaded = loop.RunUntilComplete(asyncFile.LoadAsync());
+  std::cout << sum << " " << loaded.GetSize() << std::endl;
+  // Stopping the loop leaves the task unfinished, a later Run() finishes it.
+  try {
+    loop.RunUntilComplete(StopAndSum(loop, asyncPath));
+  } catch (Exception::IOException const &exception) {
+    std::cout << exception.what() << std::endl;
+  }
+  loop.Run();
+  std::filesystem::remove(asyncPath);
+#endif
+
+#ifdef __linux__
+  // Editing a tracked file reloads it, editing an untracked sibling does not.
+  Str watchDirectory =
+      (std::filesystem::temp_directory_path() / "TIOTestWatch").string();
+  Str trackedPath = watchDirectory + "/tracked.txt";
+  Str siblingPath = watchDirectory + "/sibling.txt";
+  std::filesystem::create_directories(watchDirectory);
+  OutputFileStream(trackedPath) << "tracked";
+  OutputFileStream(siblingPath) << "sibling";
+  {
+    Watch::HotReloader reloader;
+    Atomic<Uint> reloads = 0u;
+    reloader.SetListener(
+        [&reloads](Str const &, Bool const &) { ++reloads; });
+    reloader.Track("tracked", {trackedPath},
+                   [trackedPath](Buffer::ReadBuffer &buffer) {
+                     buffer.MapFile(trackedPath);
+                   });
+    OutputFileStream(trackedPath) << "tracked again";
+    for (Uint i = 0u; i < 100u && reloader.GetVersion("tracked") < 2u; ++i) {
+      std::this_thread::sleep_for(MilliSec(10));
+    }
+    OutputFileStream(siblingPath) << "sibling again";
+    std::this_thread::sleep_for(MilliSec(200));
+    std::cout << reloader.GetVersion("tracked") << " " << reloads << " "
+              << reloader.Get("tracked")->GetSize() << std::endl;
+  }
+  std::filesystem::remove_all(watchDirectory);
+#endif
+
+  Mesh::MeshData quad;
+  quad.vertices = {{{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f}},
+                   {{1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},
+                   {{0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}},
+                   {{1.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}}};
+  quad.indices = {0u, 1u, 2u, 2u, 1u, 3u};
+  Buffer::WriteBuffer mwb;
+  Mesh::ExportMesh(quad, mwb);
+  Buffer::ReadBuffer mrb(mwb.Dump());
+  Mesh::MeshData imported = Mesh::ImportMesh(mrb);
+  std::cout << imported.vertices.size() << " " << imported.indices.size()
+            << std::endl;
+
+  // Decoded attributes stay within the quantization error. The triangle order
+  // is kept, so corners can be compared through the index buffers.
+  auto getError = [](Mesh::Vertex const &a, Mesh::Vertex const &b) {
+    Float error = 0.0f;
+    for (Uint i = 0u; i < 3u; ++i) {
+      error = std::max(error, std::abs(a.position[i] - b.position[i]));
+      error = std::max(error, std::abs(a.normal[i] - b.normal[i]));
+    }
+    for (Uint i = 0u; i < 2u; ++i) {
+      error = std::max(error, std::abs(a.uv[i] - b.uv[i]));
+    }
+    return error;
+  };
+  Mesh::ExportOptions keepOrder;
+  keepOrder.optimizeVertexCache = false;
+  Buffer::WriteBuffer indexedWb;
+  Mesh::ExportMesh(quad, indexedWb, keepOrder);
+  Buffer::ReadBuffer indexedRb(indexedWb.Dump());
+  Mesh::MeshData indexed = Mesh::ImportMesh(indexedRb);
+  Float indexedError = 0.0f;
+  for (Size i = 0u; i < quad.indices.size(); ++i) {
+    indexedError =
+        std::max(indexedError, getError(quad.vertices[quad.indices[i]],
+                                        indexed.vertices[indexed.indices[i]]));
+  }
+
+  // Meshes without indices keep every vertex.
+  Mesh::MeshData triangles;
+  for (Uint index : quad.indices) {
+    triangles.vertices.push_back(quad.vertices[index]);
+  }
+  Buffer::WriteBuffer trianglesWb;
+  Mesh::ExportMesh(triangles, trianglesWb);
+  Buffer::ReadBuffer trianglesRb(trianglesWb.Dump());
+  Mesh::MeshData decoded = Mesh::ImportMesh(trianglesRb);
+  Float trianglesError = 0.0f;
+  for (Size i = 0u; i < decoded.vertices.size(); ++i) {
+    trianglesError = std::max(
+        trianglesError, getError(triangles.vertices[i], decoded.vertices[i]));
+  }
+  std::cout << (indexedError < 1e-3f) << " " << decoded.vertices.size() << " "
+            << decoded.indices.size() << " " << (trianglesError < 1e-3f)
+            << std::endl;
+
+#ifdef TERREATEIO_INSTRUMENTATION
+  // Counts a known sequence of reads and prints it as a trace.
+  Instrument::Reset();
+  Instrument::SetTracing(true);
+  {
+    TIO_SCOPE("TIOTest", LOAD);
+    Buffer::ReadBuffer counted(Str(12u, '\0'));
+    counted.Read<Uint>();
+    counted.Fetch(4u);
+    try {
+      counted.Read<Ulong>();
+    } catch (Exception::BufferException const &) {
+    }
+  }
+  Instrument::SetTracing(false);
+  Instrument::Snapshot snapshot = Instrument::GetSnapshot();
+  std::cout << snapshot.Get(Instrument::Counter::ALLOCATIONS) << " "
+            << snapshot.Get(Instrument::Counter::READ_CALLS) << " "
+            << snapshot.Get(Instrument::Counter::FETCH_CALLS) << " "
+            << snapshot.Get(Instrument::Counter::BYTES_READ) << " "
+            << snapshot.Get(Instrument::Counter::BOUNDS_FAILURES) << " "
+            << snapshot.Get(Instrument::Latency::LOAD).count << std::endl;
+  std::cout << Instrument::CreateTraceTimeLine();
+  Instrument::Reset();
+  std::cout << Instrument::GetSnapshot().Get(Instrument::Counter::BYTES_READ)
+            << std::endl;
+#endif
 }